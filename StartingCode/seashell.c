@@ -6,22 +6,58 @@
 #include <string.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <pwd.h>
+#include <fnmatch.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include <sys/inotify.h>
 
 /*-------------------------------------------*/
 // For Part 1
 #define WHICH_DELIMITER   ":"
+// For Part 2
+#define SHORTDIR_FILE "/home/mertcan/Desktop/shortdir.txt"
+#define SHORTDIR_TEMP_FILE "/home/mertcan/Desktop/tempshortdir.txt"
+#define SHORTDIR_VISITS_FILE "/home/mertcan/Desktop/shortdir_visits.txt"
+#define SHORTDIR_VISITS_TEMP_FILE "/home/mertcan/Desktop/tempshortdir_visits.txt"
+// For Part 6
+#define ZOOM_FILE "zoom_classes.txt"
+#define ZOOM_TEMP_FILE "tempzoom_classes.txt"
 // For Part 3
 #define RED   "\x1B[31m"
 #define GREEN   "\x1B[32m"
 #define BLUE   "\x1B[34m"
 #define RESET "\x1B[0m"
 
+// Result cache
+#define CACHE_MAX_BYTES (64L*1024*1024)     // Least recently used outputs are evicted above this size
+
 #define BUFFER_SIZE 9999
 #define READ_END	0
 #define WRITE_END	1
 /*-------------------------------------------*/
 
 const char * sysname = "seashell";
+int last_status = 0;    // Exit status of the last command, reported to server clients
+bool command_child = false;     // Set in the forked child of process_command, which must exit rather than return
 
 enum return_codes {
 	SUCCESS = 0,
@@ -37,6 +73,8 @@ struct command_t {
 	char *redirects[3]; // in/out redirection
 	struct command_t *next; // for piping
 };
+char *expand_word(const char *word, bool tilde);
+int expand_glob(const char *pattern, char ***matches);
 /**
  * Prints a command struct
  * @param struct command_t *
@@ -123,11 +161,10 @@ int parse_command(char *buf, struct command_t *command)
 			command->background=true;
 
 			char *pch = strtok(buf, splitters);
-			command->name=(char *)malloc(strlen(pch)+1);
 			if (pch==NULL)
-				command->name[0]=0;
+				command->name=strdup("");
 				else
-					strcpy(command->name, pch);
+					command->name=expand_word(pch, true);  // $VAR and ~ in the command name
 
 			command->args=(char **)malloc(sizeof(char *));
 
@@ -193,15 +230,30 @@ int parse_command(char *buf, struct command_t *command)
 				}
 
 				// normal arguments
+				char quote=0;
 				if (len>2 && ((arg[0]=='"' && arg[len-1]=='"')
 						|| (arg[0]=='\'' && arg[len-1]=='\''))) // quote wrapped arg
 				{
+					quote=arg[0];
 					arg[--len]=0;
 					arg++;
 				}
-				command->args=(char **)realloc(command->args, sizeof(char *)*(arg_index+1));
-				command->args[arg_index]=(char *)malloc(len+1);
-				strcpy(command->args[arg_index++], arg);
+				// expand variables (not in '...'), ~ and globs (only unquoted)
+				char *word = quote=='\'' ? strdup(arg) : expand_word(arg, quote==0);
+				char **matches;
+				int match_count = quote==0 && strpbrk(word, "*?[") ? expand_glob(word, &matches) : 0;
+				if (match_count==0) // no glob or nothing matched, keep the word
+				{
+					matches=&word;
+					match_count=1;
+				}
+				else
+					free(word);
+				command->args=(char **)realloc(command->args, sizeof(char *)*(arg_index+match_count));
+				for (int i=0; i<match_count; ++i)
+					command->args[arg_index++]=matches[i];
+				if (matches!=&word)
+					free(matches);
 			}
 			command->arg_count=arg_index;
 			return 0;
@@ -221,7 +273,7 @@ void prompt_backspace()
 int prompt(struct command_t *command)
 {
 	int index=0;
-	char c;
+	int c;
 	char buf[4096];
 	static char oldbuf[4096];
 
@@ -248,6 +300,12 @@ int prompt(struct command_t *command)
 		c=getchar();
 		// printf("Keycode: %u\n", c); // DEBUG: uncomment for debugging
 
+		if (c==EOF) // end of input, e.g. commands piped in
+		{
+			tcsetattr(STDIN_FILENO, TCSANOW, &backup_termios);
+			return EXIT;
+		}
+
 		if (c==9) // handle tab
 		{
 			buf[index++]='?'; // autocomplete
@@ -314,271 +372,3001 @@ int prompt(struct command_t *command)
 	tcsetattr(STDIN_FILENO, TCSANOW, &backup_termios);
 	return SUCCESS;
 }
-int process_command(struct command_t *command);
-int main()
+/**
+ * Input files of highlight and kdiff, read through transparent decompression.
+ * gzip (and zstd when built with HAVE_ZSTD) is recognized by its magic bytes
+ * and decompressed while it is read, through fixed size buffers, so memory use
+ * does not depend on the file size. With more than one CPU online a thread
+ * decompresses ahead into a pipe, overlapping with the scan of the caller.
+ */
+#define INPUT_CHUNK 65536
+
+enum input_format { INPUT_PLAIN, INPUT_GZIP, INPUT_ZSTD };
+struct input {
+	int fd;             // what the caller reads: the file, or the pipe fed by the thread
+	int file;           // the file itself
+	enum input_format format;
+	unsigned char *raw;     // compressed bytes read ahead
+	bool raw_eof;
+	bool member_open;       // inside a gzip member or zstd frame, so the file must not end here
+	int error;              // errno of the first failed read, 0 if none
+	z_stream z;
+#ifdef HAVE_ZSTD
+	ZSTD_DStream *zs;
+	ZSTD_inBuffer zin;
+#endif
+	bool threaded;
+	bool joined;
+	int thread_error;       // errno of the thread, read once it is joined
+	int pipe_write;
+	pthread_t thread;
+};
+/**
+ * Refills the compressed read-ahead buffer
+ * @return bytes read, 0 at the end of the file, -1 on error
+ */
+ssize_t input_fill(struct input *in)
 {
-	while (1)
+	ssize_t n;
+	do
+		n = read(in->file, in->raw, INPUT_CHUNK);
+	while (n == -1 && errno == EINTR);
+	if (n == 0)
+		in->raw_eof = true;
+	return n;
+}
+/**
+ * Decompresses up to size bytes into out
+ * @return bytes produced, 0 at the end of the data, -1 on error
+ */
+ssize_t input_decompress(struct input *in, unsigned char *out, size_t size)
+{
+	if (in->format == INPUT_GZIP)
 	{
-		struct command_t *command=malloc(sizeof(struct command_t));
-		memset(command, 0, sizeof(struct command_t)); // set all bytes to 0
-
-		int code;
-		code = prompt(command);
-		if (code==EXIT) break;
-
-		code = process_command(command);
-		if (code==EXIT) break;
-
-		free_command(command);
+		in->z.next_out = out;
+		in->z.avail_out = size;
+		while (in->z.avail_out == size)     // Until something comes out
+		{
+			if (in->z.avail_in == 0 && !in->raw_eof)
+			{
+				ssize_t n = input_fill(in);
+				if (n == -1) return -1;
+				in->z.next_in = in->raw;
+				in->z.avail_in = n;
+			}
+			if (in->z.avail_in > 0)
+				in->member_open = true;
+			int rc = inflate(&in->z, Z_NO_FLUSH);
+			if (rc == Z_STREAM_END)
+			{
+				inflateReset(&in->z);       // Another gzip member may follow
+				in->member_open = false;
+			}
+			else if (rc == Z_BUF_ERROR && in->raw_eof && in->z.avail_in == 0)
+			{
+				if (!in->member_open) break;
+				errno = EIO;        // Truncated in the middle of a member
+				return -1;
+			}
+			else if (rc != Z_OK && rc != Z_BUF_ERROR)
+			{
+				errno = EIO;
+				return -1;
+			}
+		}
+		return size - in->z.avail_out;
+	}
+#ifdef HAVE_ZSTD
+	if (in->format == INPUT_ZSTD)
+	{
+		ZSTD_outBuffer zout = { out, size, 0 };
+		while (zout.pos == 0)
+		{
+			if (in->zin.pos == in->zin.size)
+			{
+				ssize_t n = in->raw_eof ? 0 : input_fill(in);
+				if (n == -1) return -1;
+				in->zin.src = in->raw;
+				in->zin.size = n;
+				in->zin.pos = 0;
+				if (n == 0 && !in->member_open) break;
+				if (n == 0)
+				{
+					errno = EIO;    // Truncated in the middle of a frame
+					return -1;
+				}
+			}
+			size_t rc = ZSTD_decompressStream(in->zs, &zout, &in->zin);
+			if (ZSTD_isError(rc))
+			{
+				errno = EIO;
+				return -1;
+			}
+			in->member_open = rc != 0;      // 0 once a frame is complete
+		}
+		return zout.pos;
+	}
+#endif
+	errno = ENOTSUP;
+	return -1;
+}
+void *input_thread(void *arg)
+{
+	struct input *in = arg;
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);     // A reader that stops early gives EPIPE, not a signal
+
+	unsigned char *buf = malloc(INPUT_CHUNK);
+	ssize_t n;
+	while ((n = input_decompress(in, buf, INPUT_CHUNK)) > 0)
+	{
+		for (ssize_t done = 0, w; done < n; done += w)
+		{
+			w = write(in->pipe_write, buf + done, n - done);
+			if (w == -1 && errno == EINTR) w = 0;
+			if (w == -1) goto out;
+		}
+	}
+	if (n == -1)
+		in->thread_error = errno;       // Seen by the reader once the pipe ends
+out:
+	free(buf);
+	close(in->pipe_write);
+	return NULL;
+}
+/**
+ * Wraps an open file that is read as is
+ */
+void input_plain(struct input *in, int fd)
+{
+	memset(in, 0, sizeof(struct input));
+	in->fd = in->file = fd;
+	in->format = INPUT_PLAIN;
+}
+/**
+ * Opens a file, decompressing it if it starts with a gzip or zstd header
+ * @return 0 on success, -1 with errno set on error
+ */
+int input_open(struct input *in, const char *path)
+{
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) return -1;
+	input_plain(in, fd);
+
+	unsigned char magic[4];
+	ssize_t n = pread(fd, magic, sizeof(magic), 0);
+	if (n >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+		in->format = INPUT_GZIP;
+	else if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+	{
+#ifdef HAVE_ZSTD
+		in->format = INPUT_ZSTD;
+#else
+		close(fd);
+		errno = ENOTSUP;    // zstd support not built in
+		return -1;
+#endif
+	}
+	if (in->format == INPUT_PLAIN)
+		return 0;
+
+	in->raw = malloc(INPUT_CHUNK);
+	if (in->format == INPUT_GZIP)
+		inflateInit2(&in->z, 16 + MAX_WBITS);   // Expect a gzip header
+#ifdef HAVE_ZSTD
+	if (in->format == INPUT_ZSTD)
+	{
+		in->zs = ZSTD_createDStream();
+		ZSTD_initDStream(in->zs);
+	}
+#endif
+	int p[2];
+	if (sysconf(_SC_NPROCESSORS_ONLN) > 1 && pipe(p) == 0)
+	{
+		fcntl(p[0], F_SETFD, FD_CLOEXEC);
+		fcntl(p[1], F_SETFD, FD_CLOEXEC);
+		in->fd = p[0];
+		in->pipe_write = p[1];
+		in->threaded = pthread_create(&in->thread, NULL, input_thread, in) == 0;
+		if (!in->threaded)
+		{
+			close(p[0]);
+			close(p[1]);
+			in->fd = fd;
+		}
 	}
-
-	printf("\n");
 	return 0;
 }
-
-int process_command(struct command_t *command)
+/**
+ * Estimates the decompressed length of the data without reading it: the file
+ * size for plain input, the size field of the last gzip member (which is
+ * exact for single-member files under 4 GiB), or the content size in the
+ * first zstd frame header if the compressor recorded it. Falls back to the
+ * file size.
+ */
+unsigned long input_size_estimate(struct input *in)
 {
-	int r;
-	if (strcmp(command->name, "")==0) return SUCCESS;
-
-	if (strcmp(command->name, "exit")==0)
-		return EXIT;
-
-	if (strcmp(command->name, "cd")==0)
+	struct stat st;
+	if (fstat(in->file, &st) == -1) return 0;
+	unsigned long size = st.st_size;
+	if (in->format == INPUT_GZIP && st.st_size >= 18)
 	{
-		if (command->arg_count > 0)
+		unsigned char isize[4];
+		if (pread(in->file, isize, 4, st.st_size - 4) == 4)
+			size = isize[0] | isize[1] << 8 | isize[2] << 16 | (unsigned long)isize[3] << 24;
+	}
+#ifdef HAVE_ZSTD
+	if (in->format == INPUT_ZSTD)
+	{
+		unsigned char header[18];      // Largest zstd frame header
+		ssize_t n = pread(in->file, header, sizeof(header), 0);
+		unsigned long long content = n > 0 ? ZSTD_getFrameContentSize(header, n) : ZSTD_CONTENTSIZE_UNKNOWN;
+		if (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR)
+			size = content;
+	}
+#endif
+	return size;
+}
+/**
+ * Reads up to n bytes of the (decompressed) data
+ * @return bytes read, 0 at the end, -1 on error, which is also kept in in->error
+ */
+ssize_t input_read(struct input *in, void *buf, size_t n)
+{
+	ssize_t r;
+	if (in->error)
+		r = -1;
+	else if (in->format == INPUT_PLAIN)
+		r = read(in->fd, buf, n);
+	else if (!in->threaded)
+		r = input_decompress(in, buf, n);
+	else
+	{
+		r = in->joined ? 0 : read(in->fd, buf, n);
+		if (r == 0 && !in->joined)      // The thread is done, find out how it ended
 		{
-			r=chdir(command->args[0]);
-			if (r==-1)
-				printf("-%s: %s: %s\n", sysname, command->name, strerror(errno));
-			return SUCCESS;
+			pthread_join(in->thread, NULL);
+			in->joined = true;
+			if (in->thread_error)
+			{
+				errno = in->thread_error;
+				r = -1;
+			}
 		}
 	}
-    /*-----------------------------------------------------------------------------------------------------------------------------------------------------*/
-	char read_msg[BUFFER_SIZE];
-	char write_msg[BUFFER_SIZE];
-	int fd[2];
-	if (pipe(fd) == -1) {
-		fprintf(stderr,"Pipe failed");
-		return 1;
+	if (r == -1 && in->error)
+		errno = in->error;
+	else if (r == -1 && errno != EINTR)
+		in->error = errno;
+	return r;
+}
+/**
+ * Reads until buf is full or the data ends
+ * @return bytes read, less than n at the end of the data or on error (see in->error)
+ */
+size_t input_read_full(struct input *in, void *buf, size_t n)
+{
+	size_t done = 0;
+	while (done < n)
+	{
+		ssize_t r = input_read(in, (char *)buf + done, n - done);
+		if (r == -1 && errno == EINTR) continue;
+		if (r <= 0) break;
+		done += r;
 	}
-    /*----------------------------------------------------------------------------------------------------------------------------------------------------*/
-	pid_t pid=fork();
-	if (pid==0) // child
+	return done;
+}
+void input_close(struct input *in)
+{
+	if (in->threaded)
 	{
-		/// This shows how to do exec with environ (but is not available on MacOs)
-		// extern char** environ; // environment variables
-		// execvpe(command->name, command->args, environ); // exec+args+path+environ
-
-		/// This shows how to do exec with auto-path resolve
-		// add a NULL argument to the end of args, and the name to the beginning
-		// as required by exec
-
-		// increase args size by 2
-		command->args=(char **)realloc(
-				command->args, sizeof(char *)*(command->arg_count+=2));
-
-		// shift everything forward by 1
-		for (int i=command->arg_count-2;i>0;--i)
-			command->args[i]=command->args[i-1];
-
-			// set args[0] as a copy of name
-			command->args[0]=strdup(command->name);
-			// set args[arg_count-1] (last) to NULL
-			command->args[command->arg_count-1]=NULL;
-
-			//execvp(command->name, command->args); // exec+args+path
-
-			/*---------------------------------------------------------------------------------------------------------------------------------------------*/		
-			// Part 2
-			if(strcmp(command->name,"shortdir")==0){	  
-				if(command->args[1] == NULL){
-					printf("Missing parameters\n");
-					return SUCCESS;
-				} 	    		    
-				char *comm = command->args[1];
-				char *filePath = "/home/mertcan/Desktop/shortdir.txt";
-				char *tempfilePath = "/home/mertcan/Desktop/tempshortdir.txt";
-
-				if( strcmp(comm,"set") == 0){   // shortdir set - command
-					if(command->args[2] == NULL){
-						printf("Please enter an alias name\n");
-					}
-					char *name = command->args[2];
-					char hold[1024];    // Temp string to hold the line information
-					strcpy(hold,name);
-					strcat(hold,":");
-					char cwd[1024];     // Location information
-					getcwd(cwd, sizeof(cwd));
-					char currPath[1024];
-					strcpy(currPath, cwd);
-					strcat(hold,cwd);
-					FILE *fptr;
-					fptr = fopen(filePath,"a+");    // Need both append and reading modes
-					char buffer[99999];
-					char *last_token;
-
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						last_token = strtok( buffer, ":" );
-						if(strcmp(last_token, name)==0){    // If a given name is already an existing association
-							fclose(fptr);   // To do not mess up with open files, close it and reopen it
-							fptr = fopen(filePath,"a+");
-							FILE *ftemp;    // Temporary file to hold the original file with deleted line
-							ftemp = fopen(tempfilePath,"a");
-							char buffer2[99999];
-							char *last_token2;
-							while( fgets(buffer2, 99999, fptr) != NULL ){  
-								last_token2 = strtok( buffer2, ":" );
-								if(strcmp(last_token2,name)!=0){    // Copy all the lines except the one with given name
-									char line[200];
-									strcpy(line, last_token2);
-									last_token2 = strtok( NULL, ":" );
-									strcat(line, ":");
-									strcat(line, last_token2);
-									fprintf(ftemp,"%s",line);
-								}   
-							}
-							fclose(ftemp);  // Close both files
-							fclose(fptr);
-							rename(tempfilePath,filePath);  // Change the name of temporary file to original file name
-							fptr = fopen(filePath,"a"); // Reopen the file
-						}                
-					}
-
-					fprintf(fptr,"%s\n",hold);  // Write to file
-					printf("%s is set as an alias for %s\n", name, currPath);   // Print to console
-					fclose(fptr);
-
-				} else if(strcmp(comm,"del")==0){
-					if(command->args[2] == NULL){
-						printf("Please enter an alias name\n");
-					}
-					char *name = command->args[2];
-					FILE *fptr;
-					fptr = fopen(filePath,"r"); // Open in read only
-					FILE *ftemp;
-					ftemp = fopen(tempfilePath,"a");
-
-					char buffer[99999];
-					char *last_token;
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						last_token = strtok( buffer, ":" );
-						if(strcmp(last_token,name)!=0){     // Copy all the lines except the one with given name
-							char line[200];
-							strcpy(line, last_token);
-							last_token = strtok( NULL, ":" );
-							strcat(line,":");
-							strcat(line, last_token);
-							fprintf(ftemp,"%s",line);
-						}   
-					}
-					fclose(ftemp);
-					fclose(fptr);
-					rename(tempfilePath,filePath);
-				} else if(strcmp(comm,"clear")==0){     
-					FILE *fptr;
-					fptr = fopen(filePath,"w");     // Opening a file in writing mode removes all entries in the file,
-					fclose(fptr);                   // which is enough for our purpose
-
-				} else if(strcmp(comm,"list")==0){
-					FILE *fptr;
-					fptr = fopen(filePath,"r");
-					char buffer[99999];
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						printf("%s", buffer);               // Prints all the lines  
-					}
-					fclose(fptr);
-
-				} else if(strcmp(comm,"jump")==0){    
-					if(command->args[2] == NULL){
-						printf("Please enter an alias name\n");
-					}
-					char *name = command->args[2];
-					FILE *fptr;
-					fptr = fopen(filePath,"r");     // Open in read mode
-					char buffer[99999];
-					char *last_token;
-					char line[256];
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						last_token = strtok( buffer, ":" );
-						if(strcmp(last_token,name)==0){     // Find the line with given name
-							last_token = strtok( NULL, ":" );   
-							strcpy(line, last_token);
-						}                          
-					}
-					fclose(fptr);
-					const char *path = strtok(line , "\n");     // Remove the \n at the end of the line
-
-                    //chdir(path);       // Does not change directory. So we switched to the pipes
-
-					close(fd[READ_END]);		
-					write(fd[WRITE_END], path, strlen(path)+1);     // Send the path information to the parent through a pipe
-					close(fd[WRITE_END]);
-	
-				} else {
-					printf("Invalid argument\n");
-				}
-
+		close(in->fd);      // Makes a thread blocked on the pipe give up
+		if (!in->joined)
+			pthread_join(in->thread, NULL);
+	}
+	if (in->format == INPUT_GZIP)
+		inflateEnd(&in->z);
+#ifdef HAVE_ZSTD
+	if (in->format == INPUT_ZSTD)
+		ZSTD_freeDStream(in->zs);
+#endif
+	free(in->raw);
+	close(in->file);
+}
+/**
+ * Buffered line reader shared by the file scanning builtins.
+ * Plain regular files are mapped with mmap, anything else is read in large blocks
+ * into a buffer that grows when a line does not fit, so lines have no length
+ * limit. Lines are returned as views into the map or the buffer: they are not
+ * NUL terminated and stay valid until the next call.
+ */
+#define LINE_READER_BLOCK 65536
+
+struct line_reader {
+	struct input in;
+	char *data;         // mapped file or read-ahead buffer
+	size_t size;        // mapped length or buffer capacity
+	size_t pos, end;    // unread bytes are data[pos..end)
+	size_t scanned;     // bytes after pos already known to hold no newline
+	bool mapped;
+	bool borrowed;      // data is owned by the caller, see line_reader_memory
+	bool follow;        // keep an unfinished last line until more data arrives
+};
+/**
+ * Maps the input if it is a plain regular file, else allocates the read-ahead buffer
+ */
+int line_reader_buffer(struct line_reader *r, bool follow)
+{
+	struct stat st;
+	r->follow = follow;
+	if (!follow && r->in.format == INPUT_PLAIN && fstat(r->in.fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, r->in.fd, 0);
+		if (map != MAP_FAILED)
+		{
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			r->data = map;
+			r->size = r->end = st.st_size;
+			r->mapped = true;
+			return 0;
+		}
+	}
+	r->size = LINE_READER_BLOCK;
+	r->data = malloc(r->size);
+	return r->data ? 0 : -1;
+}
+/**
+ * Sets up a reader on an open file descriptor, which the reader then owns
+ * @param  follow  the file may still grow, so never map it and hold back a last line without newline
+ * @return         0 on success, -1 on error
+ */
+int line_reader_init(struct line_reader *r, int fd, bool follow)
+{
+	memset(r, 0, sizeof(struct line_reader));
+	input_plain(&r->in, fd);
+	return line_reader_buffer(r, follow);
+}
+/**
+ * Opens a file for reading line by line, decompressing it if needed
+ * @return 0 on success, -1 with errno set on error
+ */
+int line_reader_open(struct line_reader *r, const char *path)
+{
+	memset(r, 0, sizeof(struct line_reader));
+	if (input_open(&r->in, path) == -1) return -1;
+	if (line_reader_buffer(r, false) == -1)
+	{
+		input_close(&r->in);
+		return -1;
+	}
+	return 0;
+}
+/**
+ * Sets up a reader on data already in memory, which must outlive the reader
+ */
+void line_reader_memory(struct line_reader *r, const char *data, size_t len)
+{
+	memset(r, 0, sizeof(struct line_reader));
+	r->data = (char *)data;
+	r->size = r->end = len;
+	r->mapped = r->borrowed = true;
+}
+/**
+ * Returns the next line including its newline, or NULL at the end of the data
+ * or on a read error, which leaves the error in r->in.error
+ * @param  len  set to the length of the line
+ */
+const char *line_reader_next(struct line_reader *r, size_t *len)
+{
+	const char *line;
+	while (1)
+	{
+		char *nl = memchr(r->data + r->pos + r->scanned, '\n', r->end - r->pos - r->scanned);
+		if (nl)
+		{
+			line = r->data + r->pos;
+			*len = nl + 1 - line;
+			r->pos += *len;
+			r->scanned = 0;
+			return line;
+		}
+		r->scanned = r->end - r->pos;
+		if (!r->mapped)
+		{
+			if (r->pos > 0)     // Move the unfinished line to the front
+			{
+				memmove(r->data, r->data + r->pos, r->end - r->pos);
+				r->end -= r->pos;
+				r->pos = 0;
 			}
-			// Part 3
-			else if(strcmp(command->name,"highlight")==0){		
-				if(command->args[3] == NULL || command->args[2] == NULL || command->args[1] == NULL) { // Missing parameters
-					printf("Missing parameters\n");
-					return SUCCESS;
-				}
-				char *word = command->args[1];
-				char *file = command->args[3];
-				char *color = command->args[2];
-				if(strcmp(color, "r") != 0 && strcmp(color, "g") != 0 && strcmp(color, "b") != 0){ // Invalid color
-					printf("Invalid color\n");
-					return SUCCESS;
-				}
-
-				FILE *fptr;
-				fptr = fopen(file,"r");     // Open the file in read only mode
-				char buffer[99999];
-				char *last_token;
-				char delim[] = {" ,.:;\t\r\n\v\f\0"};       // Delimiters to tokenize the text file
-				while( fgets(buffer, 99999, fptr) != NULL ){  
-					char currentLine[1024];
-					strcpy(currentLine, buffer);
-					int flag = 0;   // Flag to show, whether given word is included in that line
-					last_token = strtok( buffer, delim );
-					while( last_token != NULL ){
-						if(strcasecmp(last_token,word)==0){
-							flag = 1;
-						}
-						last_token = strtok( NULL, delim );
-					}
-					if(flag == 1){  // If given word is included in that line
-						char *inLineToken = strtok(currentLine, delim);
-						while(inLineToken){
-							if( strcasecmp(inLineToken, word) ==0){     // Case-insensitive comparing
-								if( strcmp(color, "r") == 0){
-									printf(RED "%s ", inLineToken);
-									printf(RESET);
-								} else if (strcmp(color, "g") == 0){
-									printf(GREEN "%s ", inLineToken);
-									printf(RESET);
-								} else if ( strcmp(color, "b") == 0){
-									printf(BLUE "%s ", inLineToken);
-									printf(RESET);
-								}   
-							} else {
-								printf("%s ", inLineToken);
-							}
-							inLineToken = strtok(NULL,delim);
-						}
-						printf(".\n");
-					}                        
-				}
-
+			if (r->end == r->size)      // The line fills the buffer, grow it
+			{
+				char *bigger = realloc(r->data, r->size * 2);
+				if (bigger == NULL) return NULL;
+				r->data = bigger;
+				r->size *= 2;
 			}
-			// Part 4
-			else if(strcmp(command->name,"goodMorning")==0){
-				if(command->args[2] == NULL|| command->args[1] == NULL) { // Missing parameters
-					printf("Missing parameters\n");
-					return SUCCESS;
+			ssize_t n = input_read(&r->in, r->data + r->end, r->size - r->end);
+			if (n == -1 && errno == EINTR) continue;
+			if (n == -1) return NULL;       // Cause in r->in.error
+			if (n > 0)
+			{
+				r->end += n;
+				continue;
+			}
+		}
+		if (r->pos == r->end || r->follow) return NULL;
+		line = r->data + r->pos;      // Last line without a newline
+		*len = r->end - r->pos;
+		r->pos = r->end;
+		r->scanned = 0;
+		return line;
+	}
+}
+/**
+ * Drops buffered data, e.g. after the underlying file was truncated
+ */
+void line_reader_reset(struct line_reader *r)
+{
+	r->pos = r->end = r->scanned = 0;
+}
+void line_reader_close(struct line_reader *r)
+{
+	if (r->borrowed)
+		return;
+	if (r->mapped)
+		munmap(r->data, r->size);
+	else
+		free(r->data);
+	input_close(&r->in);
+	r->data = NULL;
+}
+/**
+ * Checks whether a line is the entry of the given name, i.e. starts with
+ * the name followed by the field separator
+ */
+bool entry_matches(const char *line, size_t len, const char *name, char sep)
+{
+	size_t n = strlen(name);
+	return len > n && line[n] == sep && memcmp(line, name, n) == 0;
+}
+/**
+ * Rewrites a list file without the entry of the given name, through a
+ * temporary file renamed over the original
+ * @return 0 on success (also if the file does not exist yet), -1 on error
+ */
+int remove_entry(const char *path, const char *temp_path, const char *name, char sep)
+{
+	struct line_reader r;
+	if (line_reader_open(&r, path) == -1)
+		return errno == ENOENT ? 0 : -1;
+	FILE *ftemp = fopen(temp_path, "w");
+	if (ftemp == NULL)
+	{
+		line_reader_close(&r);
+		return -1;
+	}
+	const char *line;
+	size_t len;
+	while ((line = line_reader_next(&r, &len)) != NULL)
+		if (!entry_matches(line, len, name, sep))   // Copy all the lines except the one with given name
+			fwrite(line, 1, len, ftemp);
+	fclose(ftemp);
+	line_reader_close(&r);
+	return rename(temp_path, path);
+}
+/**
+ * The shortdir alias list and the zoom class list, held in memory by the
+ * shell so that list, jump and zoom -o do not read the file again. Loaded
+ * before the fork, like the visit index, and loaded again when the file has
+ * changed since, e.g. after set or del or a write by another shell.
+ */
+struct list_table {
+	const char *path;
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	char *data;         // file contents, NULL if the file does not exist
+	size_t len;
+};
+struct list_table alias_table = { SHORTDIR_FILE };
+struct list_table zoom_table = { ZOOM_FILE };
+/**
+ * Brings the table up to date with its file
+ */
+void list_table_load(struct list_table *t)
+{
+	struct stat st;
+	int fd = open(t->path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1 || fstat(fd, &st) == -1)
+	{
+		if (fd != -1) close(fd);
+		free(t->data);
+		t->data = NULL;
+		t->len = 0;
+		return;
+	}
+	if (t->data != NULL && st.st_dev == t->dev && st.st_ino == t->ino && st.st_size == t->size
+			&& st.st_mtim.tv_sec == t->mtime.tv_sec && st.st_mtim.tv_nsec == t->mtime.tv_nsec)
+	{
+		close(fd);      // Unchanged
+		return;
+	}
+	free(t->data);
+	t->data = malloc(st.st_size + 1);
+	t->len = 0;
+	while (t->data != NULL && t->len < (size_t)st.st_size)
+	{
+		ssize_t n = read(fd, t->data + t->len, st.st_size - t->len);
+		if (n == -1 && errno == EINTR) continue;
+		if (n <= 0) break;
+		t->len += n;
+	}
+	close(fd);
+	t->dev = st.st_dev;
+	t->ino = st.st_ino;
+	t->size = st.st_size;
+	t->mtime = st.st_mtim;
+}
+/**
+ * 64-bit FNV-1a hash, used as the strong block hash of kdiff -d
+ */
+uint64_t fnv1a64(const unsigned char *data, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= data[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+/**
+ * Regular expressions for highlight -e.
+ * A pattern is parsed into a tree, compiled to a Thompson NFA and matched
+ * with DFAs whose states are built lazily, the first time a byte leads out
+ * of them. Matching never backtracks, and the scans for the matches of a line
+ * share their work, so matching is linear in the input.
+ * Supported syntax: literals, ., [...] and [^...] with ranges, \d \w \s
+ * (and \D \W \S), escaped metacharacters, grouping, |, *, +, ? and {m,n}.
+ */
+#define REGEX_MAX_NFA 10000     // Bounds the compiled size of untrusted patterns
+#define REGEX_MAX_REPEAT 1000
+#define REGEX_MAX_DFA 1024      // DFA states kept before the cache is flushed
+#define REGEX_MEMO_PER_BYTE 16  // Scan memo entries per byte of a line before it starts over
+
+enum regex_node_type { RX_SET, RX_CAT, RX_ALT, RX_REPEAT, RX_EMPTY };
+struct regex_node {
+	enum regex_node_type type;
+	unsigned char set[32];      // RX_SET: bitmap of the accepted bytes
+	struct regex_node *left, *right;
+	int min, max;               // RX_REPEAT, max is -1 if unbounded
+};
+struct regex_parser {
+	const char *p;
+	const char *error;
+};
+enum nfa_type { NFA_SET, NFA_SPLIT, NFA_MATCH };
+struct nfa_state {
+	enum nfa_type type;
+	unsigned char set[32];
+	int out, out1;
+};
+struct nfa {
+	struct nfa_state *states;
+	int count;
+	int start;
+};
+struct dfa_state {
+	int *set;       // sorted NFA states
+	int size;
+	bool match;
+	int next[256];  // -1 until the transition is first taken
+};
+struct dfa {
+	struct nfa *nfa;
+	bool unanchored;    // a match may begin at any byte
+	struct dfa_state *states;
+	int count;
+	int start;          // -1 until built
+	unsigned epoch;     // counts cache flushes
+	int table[REGEX_MAX_DFA * 2];  // hash of state sets to state ids
+	int *list, *stack, *mark, generation;
+};
+/**
+ * Results of the anchored scans of one line: the longest match end reachable
+ * from a (position, DFA state) pair that a scan went through
+ */
+struct scan_memo_entry {
+	int state;
+	long next;          // next entry of the same position, -1 at the end
+	size_t end;         // SCAN_NO_MATCH if no match ends at or after the position
+};
+struct scan_memo {
+	struct scan_memo_entry *entries;
+	size_t count, cap;
+	long *head;             // first entry of each position of the line
+	unsigned *generation;   // head[p] is only valid if generation[p] == current
+	unsigned current;
+	unsigned epoch;         // anchored DFA cache epoch the states belong to
+	size_t *path;           // positions the running scan went through
+	int *path_state;        // and its states there
+	size_t positions;       // allocated length of the arrays above
+};
+struct regex {
+	struct nfa forward, reverse;
+	struct dfa anchored;            // forward, from a known match start
+	struct dfa reverse_unanchored;  // backwards over a line, to find match starts
+	struct scan_memo memo;
+};
+
+void set_add(unsigned char *set, int c) { set[c >> 3] |= 1 << (c & 7); }
+bool set_has(const unsigned char *set, int c) { return set[c >> 3] & (1 << (c & 7)); }
+
+struct regex_node *rx_node(enum regex_node_type type)
+{
+	struct regex_node *n = calloc(1, sizeof(struct regex_node));
+	n->type = type;
+	return n;
+}
+void rx_free_node(struct regex_node *n)
+{
+	if (n == NULL) return;
+	rx_free_node(n->left);
+	rx_free_node(n->right);
+	free(n);
+}
+/**
+ * Adds the bytes of a backslash escape to set, the escape letter is at *p
+ */
+void rx_escape(const char **p, unsigned char *set)
+{
+	unsigned char tmp[32] = {0};
+	char c = *(*p)++;
+	int lower = c | 0x20;
+	if (lower == 'd' || lower == 'w' || lower == 's')
+	{
+		for (int i = 0; i < 256; i++)
+			if ((lower == 'd' && i >= '0' && i <= '9')
+					|| (lower == 'w' && (i == '_' || (i >= '0' && i <= '9') || ((i | 0x20) >= 'a' && (i | 0x20) <= 'z')))
+					|| (lower == 's' && i < 128 && strchr(" \t\n\r\f\v", i) && i))
+				set_add(tmp, i);
+		for (int i = 0; i < 32; i++)
+			set[i] |= c == lower ? tmp[i] : (unsigned char)~tmp[i];    // Upper case is the complement
+		return;
+	}
+	set_add(set, c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : (unsigned char)c);
+}
+struct regex_node *rx_parse_alt(struct regex_parser *ps);
+struct regex_node *rx_parse_atom(struct regex_parser *ps)
+{
+	struct regex_node *n;
+	char c = *ps->p;
+	if (c == '(')
+	{
+		ps->p++;
+		n = rx_parse_alt(ps);
+		if (ps->error) return n;
+		if (*ps->p != ')') ps->error = "missing )";
+		else ps->p++;
+		return n;
+	}
+	n = rx_node(RX_SET);
+	if (c == '.')
+	{
+		ps->p++;
+		for (int i = 0; i < 256; i++)
+			if (i != '\n') set_add(n->set, i);
+	}
+	else if (c == '\\')
+	{
+		ps->p++;
+		if (*ps->p == 0) ps->error = "trailing \\";
+		else rx_escape(&ps->p, n->set);
+	}
+	else if (c == '[')
+	{
+		bool negate = *++ps->p == '^';
+		if (negate) ps->p++;
+		bool first = true;
+		while (*ps->p && (*ps->p != ']' || first))
+		{
+			first = false;
+			if (*ps->p == '\\' && ps->p[1])
+			{
+				ps->p++;
+				rx_escape(&ps->p, n->set);
+				continue;
+			}
+			unsigned char lo = *ps->p++, hi = lo;
+			if (*ps->p == '-' && ps->p[1] && ps->p[1] != ']')
+			{
+				hi = ps->p[1];
+				ps->p += 2;
+			}
+			if (lo > hi)
+			{
+				ps->error = "invalid range";
+				return n;
+			}
+			for (int i = lo; i <= hi; i++)
+				set_add(n->set, i);
+		}
+		if (*ps->p != ']') ps->error = "missing ]";
+		else ps->p++;
+		if (negate)
+			for (int i = 0; i < 32; i++)
+				n->set[i] = ~n->set[i];
+	}
+	else if (c == '*' || c == '+' || c == '?' || c == '{')
+		ps->error = "nothing to repeat";
+	else
+		set_add(n->set, (unsigned char)*ps->p++);
+	return n;
+}
+/**
+ * Parses a count of a {m,n} repeat, which is a plain decimal number
+ * @return the count, -1 if there is none or it is above REGEX_MAX_REPEAT
+ */
+int rx_parse_count(struct regex_parser *ps)
+{
+	if (!isdigit((unsigned char)*ps->p)) return -1;     // Also rejects a sign
+	char *end;
+	long n = strtol(ps->p, &end, 10);
+	ps->p = end;
+	return n > REGEX_MAX_REPEAT ? -1 : (int)n;
+}
+struct regex_node *rx_parse_repeat(struct regex_parser *ps)
+{
+	struct regex_node *n = rx_parse_atom(ps);
+	while (!ps->error && *ps->p && strchr("*+?{", *ps->p))
+	{
+		struct regex_node *r = rx_node(RX_REPEAT);
+		r->left = n;
+		n = r;
+		char c = *ps->p++;
+		r->min = c == '+' ? 1 : 0;
+		r->max = c == '?' ? 1 : -1;
+		if (c == '{')
+		{
+			r->min = r->max = rx_parse_count(ps);
+			if (r->min == -1) { ps->error = "invalid {}"; break; }
+			if (*ps->p == ',')
+			{
+				ps->p++;
+				r->max = -1;
+				if (*ps->p != '}' && (r->max = rx_parse_count(ps)) == -1) { ps->error = "invalid {}"; break; }
+			}
+			if (*ps->p++ != '}' || (r->max != -1 && r->max < r->min))
+				ps->error = "invalid {}";
+		}
+	}
+	return n;
+}
+struct regex_node *rx_parse_cat(struct regex_parser *ps)
+{
+	struct regex_node *n = rx_node(RX_EMPTY);
+	while (!ps->error && *ps->p && *ps->p != '|' && *ps->p != ')')
+	{
+		struct regex_node *cat = rx_node(RX_CAT);
+		cat->left = n;
+		cat->right = rx_parse_repeat(ps);
+		n = cat;
+	}
+	return n;
+}
+struct regex_node *rx_parse_alt(struct regex_parser *ps)
+{
+	struct regex_node *n = rx_parse_cat(ps);
+	while (!ps->error && *ps->p == '|')
+	{
+		ps->p++;
+		struct regex_node *alt = rx_node(RX_ALT);
+		alt->left = n;
+		alt->right = rx_parse_cat(ps);
+		n = alt;
+	}
+	return n;
+}
+int nfa_add(struct nfa *n, enum nfa_type type, int out, int out1)
+{
+	if (n->count == REGEX_MAX_NFA) return -1;
+	n->states[n->count].type = type;
+	n->states[n->count].out = out;
+	n->states[n->count].out1 = out1;
+	return n->count++;
+}
+/**
+ * Compiles a tree into NFA states that continue to state next. Built back to
+ * front, so reverse only has to swap the halves of concatenations.
+ * @return first state of the fragment, -1 if the NFA grows too large
+ */
+int nfa_compile(struct nfa *n, struct regex_node *node, int next, bool reverse)
+{
+	int s, body;
+	if (next == -1) return -1;
+	switch (node->type)
+	{
+	case RX_EMPTY:
+		return next;
+	case RX_SET:
+		s = nfa_add(n, NFA_SET, next, -1);
+		if (s != -1) memcpy(n->states[s].set, node->set, 32);
+		return s;
+	case RX_CAT:
+		if (reverse)
+			return nfa_compile(n, node->right, nfa_compile(n, node->left, next, reverse), reverse);
+		return nfa_compile(n, node->left, nfa_compile(n, node->right, next, reverse), reverse);
+	case RX_ALT:
+		body = nfa_compile(n, node->left, next, reverse);
+		s = nfa_compile(n, node->right, next, reverse);
+		return body == -1 || s == -1 ? -1 : nfa_add(n, NFA_SPLIT, body, s);
+	case RX_REPEAT:
+		s = next;
+		if (node->max == -1)    // Loop: split to the body, which comes back to the split
+		{
+			s = nfa_add(n, NFA_SPLIT, -1, next);
+			if (s == -1) return -1;
+			body = nfa_compile(n, node->left, s, reverse);
+			if (body == -1) return -1;
+			n->states[s].out = body;
+		}
+		else
+			for (int i = node->min; i < node->max && s != -1; i++)      // Optional copies
+			{
+				body = nfa_compile(n, node->left, s, reverse);
+				s = body == -1 ? -1 : nfa_add(n, NFA_SPLIT, body, next);
+			}
+		for (int i = 0; i < node->min && s != -1; i++)     // Required copies
+			s = nfa_compile(n, node->left, s, reverse);
+		return s;
+	}
+	return -1;
+}
+int int_compare(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+/**
+ * Adds NFA state s and everything reachable from it without input to the list
+ */
+void dfa_closure(struct dfa *d, int *count, int s)
+{
+	int top = 0;
+	d->stack[top++] = s;
+	while (top > 0)
+	{
+		s = d->stack[--top];
+		if (d->mark[s] == d->generation) continue;
+		d->mark[s] = d->generation;
+		d->list[(*count)++] = s;
+		if (d->nfa->states[s].type == NFA_SPLIT)
+		{
+			d->stack[top++] = d->nfa->states[s].out1;
+			d->stack[top++] = d->nfa->states[s].out;
+		}
+	}
+}
+void dfa_flush(struct dfa *d)
+{
+	for (int i = 0; i < d->count; i++)
+		free(d->states[i].set);
+	d->count = 0;
+	d->start = -1;
+	d->epoch++;
+	for (int i = 0; i < REGEX_MAX_DFA * 2; i++)
+		d->table[i] = -1;
+}
+void dfa_init(struct dfa *d, struct nfa *nfa, bool unanchored)
+{
+	d->nfa = nfa;
+	d->unanchored = unanchored;
+	d->states = malloc(sizeof(struct dfa_state) * REGEX_MAX_DFA);
+	d->list = malloc(sizeof(int) * nfa->count);
+	d->stack = malloc(sizeof(int) * nfa->count * 2);
+	d->mark = calloc(nfa->count, sizeof(int));
+	d->generation = 0;
+	d->count = 0;
+	d->epoch = 0;
+	dfa_flush(d);
+}
+void dfa_free(struct dfa *d)
+{
+	dfa_flush(d);
+	free(d->states);
+	free(d->list);
+	free(d->stack);
+	free(d->mark);
+}
+/**
+ * Finds or adds the DFA state for the NFA states in d->list. A full cache is
+ * flushed first, so ids handed out before are no longer valid.
+ */
+int dfa_intern(struct dfa *d, int size)
+{
+	qsort(d->list, size, sizeof(int), int_compare);
+	uint64_t h = fnv1a64((const unsigned char *)d->list, size * sizeof(int));
+	size_t slot = h % (REGEX_MAX_DFA * 2);
+	for (; d->table[slot] != -1; slot = (slot + 1) % (REGEX_MAX_DFA * 2))
+	{
+		struct dfa_state *st = &d->states[d->table[slot]];
+		if (st->size == size && memcmp(st->set, d->list, size * sizeof(int)) == 0)
+			return d->table[slot];
+	}
+	if (d->count == REGEX_MAX_DFA)
+	{
+		dfa_flush(d);
+		return dfa_intern(d, size);
+	}
+	struct dfa_state *st = &d->states[d->count];
+	st->set = malloc(sizeof(int) * (size ? size : 1));
+	memcpy(st->set, d->list, size * sizeof(int));
+	st->size = size;
+	st->match = false;
+	for (int i = 0; i < size; i++)
+		if (d->nfa->states[d->list[i]].type == NFA_MATCH)
+			st->match = true;
+	memset(st->next, -1, sizeof(st->next));
+	d->table[slot] = d->count;
+	return d->count++;
+}
+int dfa_start(struct dfa *d)
+{
+	if (d->start == -1)
+	{
+		int count = 0;
+		d->generation++;
+		dfa_closure(d, &count, d->nfa->start);
+		d->start = dfa_intern(d, count);
+	}
+	return d->start;
+}
+/**
+ * Follows the transition of a DFA state on byte c, building it if needed
+ */
+int dfa_step(struct dfa *d, int state, unsigned char c)
+{
+	struct dfa_state *st = &d->states[state];
+	if (st->next[c] != -1)
+		return st->next[c];
+	int count = 0;
+	d->generation++;
+	for (int i = 0; i < st->size; i++)
+	{
+		struct nfa_state *ns = &d->nfa->states[st->set[i]];
+		if (ns->type == NFA_SET && set_has(ns->set, c))
+			dfa_closure(d, &count, ns->out);
+	}
+	if (d->unanchored)
+		dfa_closure(d, &count, d->nfa->start);
+	unsigned epoch = d->epoch;
+	int next = dfa_intern(d, count);
+	if (d->epoch == epoch)      // state is gone if the cache was flushed meanwhile
+		st->next[c] = next;
+	return next;
+}
+/**
+ * Compiles a pattern
+ * @param  error  set to a description of the problem if the pattern is invalid
+ * @return        the compiled pattern, or NULL
+ */
+struct regex *regex_compile(const char *pattern, const char **error)
+{
+	struct regex_parser ps = { pattern, NULL };
+	struct regex_node *tree = rx_parse_alt(&ps);
+	if (!ps.error && *ps.p != 0)
+		ps.error = "unmatched )";
+	struct regex *rx = calloc(1, sizeof(struct regex));
+	struct nfa *nfas[2] = { &rx->forward, &rx->reverse };
+	for (int i = 0; i < 2 && !ps.error; i++)
+	{
+		nfas[i]->states = malloc(sizeof(struct nfa_state) * REGEX_MAX_NFA);
+		nfas[i]->start = nfa_compile(nfas[i], tree, nfa_add(nfas[i], NFA_MATCH, -1, -1), i == 1);
+		if (nfas[i]->start == -1)
+			ps.error = "pattern too large";
+	}
+	rx_free_node(tree);
+	if (ps.error)
+	{
+		*error = ps.error;
+		free(rx->forward.states);
+		free(rx->reverse.states);
+		free(rx);
+		return NULL;
+	}
+	dfa_init(&rx->anchored, &rx->forward, false);
+	dfa_init(&rx->reverse_unanchored, &rx->reverse, true);
+	return rx;
+}
+void regex_free(struct regex *rx)
+{
+	dfa_free(&rx->anchored);
+	dfa_free(&rx->reverse_unanchored);
+	free(rx->memo.entries);
+	free(rx->memo.head);
+	free(rx->memo.generation);
+	free(rx->memo.path);
+	free(rx->memo.path_state);
+	free(rx->forward.states);
+	free(rx->reverse.states);
+	free(rx);
+}
+#define SCAN_NO_MATCH ((size_t)-1)
+#define SCAN_UNKNOWN ((size_t)-2)
+
+void scan_memo_clear(struct scan_memo *m)
+{
+	m->count = 0;
+	if (++m->current == 0)      // Wrapped around, forget the old stamps
+	{
+		memset(m->generation, 0, sizeof(unsigned) * m->positions);
+		m->current = 1;
+	}
+}
+/**
+ * Empties the memo for a line of the given length
+ */
+void scan_memo_line(struct scan_memo *m, size_t len)
+{
+	if (len + 1 > m->positions)
+	{
+		m->positions = len + 1;
+		m->head = realloc(m->head, sizeof(long) * m->positions);
+		m->generation = realloc(m->generation, sizeof(unsigned) * m->positions);
+		memset(m->generation, 0, sizeof(unsigned) * m->positions);
+		m->path = realloc(m->path, sizeof(size_t) * m->positions);
+		m->path_state = realloc(m->path_state, sizeof(int) * m->positions);
+	}
+	if (m->cap < REGEX_MEMO_PER_BYTE * (len + 1))
+	{
+		m->cap = REGEX_MEMO_PER_BYTE * (len + 1);
+		m->entries = realloc(m->entries, sizeof(struct scan_memo_entry) * m->cap);
+	}
+	scan_memo_clear(m);
+}
+size_t scan_memo_find(struct scan_memo *m, size_t pos, int state)
+{
+	if (m->generation[pos] != m->current) return SCAN_UNKNOWN;
+	for (long e = m->head[pos]; e != -1; e = m->entries[e].next)
+		if (m->entries[e].state == state)
+			return m->entries[e].end;
+	return SCAN_UNKNOWN;
+}
+void scan_memo_add(struct scan_memo *m, size_t pos, int state, size_t end)
+{
+	if (m->count == m->cap)     // Full, start over
+		scan_memo_clear(m);
+	if (m->generation[pos] != m->current)
+	{
+		m->generation[pos] = m->current;
+		m->head[pos] = -1;
+	}
+	m->entries[m->count] = (struct scan_memo_entry){ state, m->head[pos], end };
+	m->head[pos] = m->count++;
+}
+/**
+ * Finds the longest match that begins at start with the anchored DFA. The
+ * scan stops where no match can continue, or where it reaches a position in
+ * a state an earlier scan of the line went through, and takes that scan's
+ * result from the memo. So each (position, state) pair is scanned once per
+ * line, however many match starts lead through it.
+ * @return end of the match, start if there is no non-empty match
+ */
+size_t regex_longest(struct regex *rx, const char *line, size_t len, size_t start)
+{
+	struct dfa *d = &rx->anchored;
+	struct scan_memo *m = &rx->memo;
+	int st = dfa_start(d);
+	if (m->epoch != d->epoch)   // State ids changed, the memo no longer applies
+	{
+		scan_memo_clear(m);
+		m->epoch = d->epoch;
+	}
+	size_t end = start, steps = 0;
+	bool memo = true;
+	for (size_t p = start; ; )
+	{
+		if (p > start && memo)
+		{
+			size_t known = scan_memo_find(m, p, st);
+			if (known != SCAN_UNKNOWN)
+			{
+				if (known != SCAN_NO_MATCH)
+					end = known;
+				break;
+			}
+			m->path[steps] = p;
+			m->path_state[steps++] = st;
+		}
+		if (d->states[st].match) end = p;
+		if (p == len) break;
+		st = dfa_step(d, st, line[p++]);
+		if (d->epoch != m->epoch) memo = false;     // Flushed during the scan
+		if (d->states[st].size == 0) break;     // No match can continue
+	}
+	if (memo)
+		for (size_t i = 0; i < steps; i++)
+			scan_memo_add(m, m->path[i], m->path_state[i], end >= m->path[i] ? end : SCAN_NO_MATCH);
+	return end;
+}
+/**
+ * Prints a line with every match of the pattern colored in place, if there
+ * is a match. A backwards pass marks where matches begin, then the longest
+ * match is taken from the leftmost start; empty matches are not shown.
+ */
+void highlight_regex_line(struct regex *rx, const char *line, size_t len, const char *code)
+{
+	if (len > 0 && line[len-1] == '\n')
+		len--;
+	unsigned char *starts = calloc(len + 1, 1);
+	bool any = false;
+	int st = dfa_start(&rx->reverse_unanchored);
+	for (size_t i = len; i-- > 0; )
+	{
+		st = dfa_step(&rx->reverse_unanchored, st, line[i]);
+		if (rx->reverse_unanchored.states[st].match)
+		{
+			starts[i] = 1;
+			any = true;
+		}
+	}
+	if (!any)
+	{
+		free(starts);
+		return;
+	}
+	scan_memo_line(&rx->memo, len);
+	size_t printed = 0, i = 0;
+	bool shown = false;
+	while (i < len)
+	{
+		if (!starts[i])
+		{
+			i++;
+			continue;
+		}
+		size_t end = regex_longest(rx, line, len, i);
+		if (end == i)
+		{
+			i++;
+			continue;
+		}
+		printf("%.*s%s%.*s" RESET, (int)(i - printed), line + printed, code, (int)(end - i), line + i);
+		printed = i = end;
+		shown = true;
+	}
+	if (shown)
+		printf("%.*s\n", (int)(len - printed), line + printed);
+	free(starts);
+}
+/**
+ * Prints a line with the given word highlighted, if the line contains the word
+ * @param line  line of text, not NUL terminated
+ * @param len   length of the line
+ * @param word  word to highlight, compared case-insensitively
+ * @param color r, g or b
+ * @param rx    compiled pattern for highlight -e, in which case word is not used
+ */
+void highlight_line(const char *line, size_t len, const char *word, const char *color, struct regex *rx)
+{
+	if (rx != NULL)
+	{
+		highlight_regex_line(rx, line, len, strcmp(color, "r") == 0 ? RED : strcmp(color, "g") == 0 ? GREEN : BLUE);
+		return;
+	}
+	const char *delim = " ,.:;\t\r\n\v\f";     // Delimiters to tokenize the text file
+	size_t word_len = strlen(word);
+	size_t i, start;
+	int flag = 0;   // Flag to show, whether given word is included in that line
+	for (i = 0; i < len && !flag; )
+	{
+		while (i < len && strchr(delim, line[i]) && line[i]) i++;
+		start = i;
+		while (i < len && !(strchr(delim, line[i]) && line[i])) i++;
+		if (i - start == word_len && word_len > 0 && strncasecmp(line + start, word, word_len) == 0)
+			flag = 1;
+	}
+	if(flag == 1){  // If given word is included in that line
+		const char *code = strcmp(color, "r") == 0 ? RED : strcmp(color, "g") == 0 ? GREEN : BLUE;
+		for (i = 0; i < len; )
+		{
+			while (i < len && strchr(delim, line[i]) && line[i]) i++;
+			start = i;
+			while (i < len && !(strchr(delim, line[i]) && line[i])) i++;
+			if (i == start) break;
+			if (i - start == word_len && strncasecmp(line + start, word, word_len) == 0)    // Case-insensitive comparing
+				printf("%s%.*s " RESET, code, (int)(i - start), line + start);
+			else
+				printf("%.*s ", (int)(i - start), line + start);
+		}
+		printf(".\n");
+	}
+}
+/**
+ * Highlights the complete lines appended to the followed file since the last call
+ */
+void highlight_drain(struct line_reader *r, const char *word, const char *color, struct regex *rx)
+{
+	const char *line;
+	size_t len;
+	while ((line = line_reader_next(r, &len)) != NULL)
+		highlight_line(line, len, word, color, rx);
+	fflush(stdout);
+}
+/**
+ * highlight -f: highlights the file, then keeps it open and highlights the
+ * lines appended to it. Sleeps on inotify between writes, so an idle log costs
+ * nothing. Truncation restarts from the beginning of the file and rotation
+ * (rename or delete followed by a new file at the same path) reopens the path.
+ * Runs until the process is killed.
+ * @param file  path of the file to follow
+ */
+void highlight_follow(const char *file, const char *word, const char *color, struct regex *rx)
+{
+	struct line_reader r;
+	char dirbuf[1024], basebuf[1024];
+	strncpy(dirbuf, file, sizeof(dirbuf)-1);
+	dirbuf[sizeof(dirbuf)-1] = 0;
+	strncpy(basebuf, file, sizeof(basebuf)-1);
+	basebuf[sizeof(basebuf)-1] = 0;
+	char *dir = dirname(dirbuf);
+	char *base = basename(basebuf);
+
+	int fd = open(file, O_RDONLY);
+	if (fd == -1)
+	{
+		printf("-%s: highlight: %s: %s\n", sysname, file, strerror(errno));
+		return;
+	}
+	line_reader_init(&r, fd, true);
+	int in = inotify_init1(IN_CLOEXEC);
+	if (in == -1)
+	{
+		printf("-%s: highlight: inotify: %s\n", sysname, strerror(errno));
+		line_reader_close(&r);
+		return;
+	}
+	const uint32_t file_mask = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+	int wfile = inotify_add_watch(in, file, file_mask);
+	int wdir = inotify_add_watch(in, dir, IN_CREATE | IN_MOVED_TO);   // To notice a rotated file reappearing
+
+	highlight_drain(&r, word, color, rx);
+
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (1)
+	{
+		ssize_t len = read(in, events, sizeof(events));    // Blocks until the file or its directory changes
+		if (len == -1)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+		bool modified = false, reopen = false;
+		for (char *p = events; p < events + len; )
+		{
+			struct inotify_event *ev = (struct inotify_event *)p;
+			if (ev->wd == wfile)
+			{
+				if (ev->mask & (IN_MODIFY | IN_ATTRIB))
+					modified = true;
+				if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF))
+					reopen = true;
+			}
+			else if (ev->wd == wdir && ev->len > 0 && strcmp(ev->name, base) == 0)
+				reopen = true;
+			p += sizeof(struct inotify_event) + ev->len;
+		}
+
+		if (modified)
+		{
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size < lseek(fd, 0, SEEK_CUR))    // Truncated, start over
+			{
+				lseek(fd, 0, SEEK_SET);
+				line_reader_reset(&r);
+			}
+			highlight_drain(&r, word, color, rx);
+		}
+		if (reopen)
+		{
+			highlight_drain(&r, word, color, rx);   // Finish the rotated file first
+			int nfd = open(file, O_RDONLY);
+			if (nfd == -1) continue;    // Not recreated yet, the directory watch will tell us
+			struct stat oldst, newst;
+			if (fstat(fd, &oldst) == 0 && fstat(nfd, &newst) == 0
+					&& oldst.st_ino == newst.st_ino && oldst.st_dev == newst.st_dev)
+			{
+				close(nfd);     // Still the same file
+				continue;
+			}
+			line_reader_close(&r);
+			fd = nfd;
+			line_reader_init(&r, fd, true);
+			if (wfile != -1)
+				inotify_rm_watch(in, wfile);
+			wfile = inotify_add_watch(in, file, file_mask);
+			highlight_drain(&r, word, color, rx);
+		}
+	}
+	close(in);
+	line_reader_close(&r);
+}
+/**
+ * rsync style weak checksum of a block: a is the byte sum and b the sum
+ * weighted by distance to the block end, both mod 2^16
+ */
+void weak_checksum(const unsigned char *data, size_t len, uint32_t *a, uint32_t *b)
+{
+	uint32_t s1 = 0, s2 = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		s1 += data[i];
+		s2 += (uint32_t)(len - i) * data[i];
+	}
+	*a = s1 & 0xffff;
+	*b = s2 & 0xffff;
+}
+struct delta_block {
+	uint32_t weak;
+	uint64_t strong;
+	long next;      // next block in the same hash bucket, -1 at the end
+	bool used;
+};
+struct delta_state {
+	unsigned long copy_off, copy_len;   // copy being coalesced
+	unsigned long literal;              // pending inserted bytes
+	unsigned long inserted, copied;
+};
+void delta_flush_literal(struct delta_state *d)
+{
+	if (d->literal == 0) return;
+	if (d->copy_len)
+	{
+		printf("copy   %lu %lu\n", d->copy_off, d->copy_len);
+		d->copy_len = 0;
+	}
+	printf("insert %lu\n", d->literal);
+	d->inserted += d->literal;
+	d->literal = 0;
+}
+void delta_copy(struct delta_state *d, unsigned long off, unsigned long len)
+{
+	delta_flush_literal(d);
+	if (d->copy_len && d->copy_off + d->copy_len == off)    // Continues the previous copy
+	{
+		d->copy_len += len;
+		return;
+	}
+	if (d->copy_len)
+		printf("copy   %lu %lu\n", d->copy_off, d->copy_len);
+	d->copy_off = off;
+	d->copy_len = len;
+}
+/**
+ * kdiff -d: finds the regions of file2 that also appear in file1, even if
+ * they moved, and lists the copy/insert operations that describe file2 in
+ * terms of file1.
+ * file1 is split into fixed blocks indexed by a weak rolling checksum and a
+ * strong hash. file2 is then streamed once with a window that rolls one byte
+ * at a time; every weak hit is confirmed with the strong hash.
+ * "copy OFFSET LENGTH" is a range of file1, "insert LENGTH" counts bytes
+ * found only in file2; their contents are not printed.
+ * @return 0 on success, -1 if a file cannot be read
+ */
+int kdiff_delta(const char *file1, const char *file2)
+{
+	struct input f1, f2;
+	if (input_open(&f1, file1) == -1)
+	{
+		printf("-%s: kdiff: %s: %s\n", sysname, file1, strerror(errno));
+		return -1;
+	}
+	if (input_open(&f2, file2) == -1)
+	{
+		printf("-%s: kdiff: %s: %s\n", sysname, file2, strerror(errno));
+		input_close(&f1);
+		return -1;
+	}
+
+	unsigned long size1 = input_size_estimate(&f1);    // Decompressed length, only used to pick the block size
+	size_t block = 512;     // Roughly sqrt of the file size, as rsync does
+	while ((unsigned long)block * block < size1 && block < 65536)
+		block *= 2;
+
+	// Signatures of the full blocks of file1
+	size_t nblocks = 0, cap_blocks = 64;
+	struct delta_block *blocks = malloc(sizeof(struct delta_block) * cap_blocks);
+	unsigned char *buf = malloc(block);
+	uint32_t a, b;
+	size_t tail_len;
+	while ((tail_len = input_read_full(&f1, buf, block)) == block)
+	{
+		if (nblocks == cap_blocks)
+		{
+			cap_blocks *= 2;
+			blocks = realloc(blocks, sizeof(struct delta_block) * cap_blocks);
+		}
+		weak_checksum(buf, block, &a, &b);
+		blocks[nblocks].weak = a | (b << 16);
+		blocks[nblocks].strong = fnv1a64(buf, block);
+		blocks[nblocks].used = false;
+		nblocks++;
+	}
+	uint64_t tail_strong = fnv1a64(buf, tail_len);     // The short last block only matches the end of file2
+	free(buf);
+	input_close(&f1);
+	if (f1.error)
+	{
+		printf("-%s: kdiff: %s: %s\n", sysname, file1, strerror(f1.error));
+		input_close(&f2);
+		free(blocks);
+		return -1;
+	}
+
+	size_t nbuckets = 1;
+	while (nbuckets < nblocks * 2)
+		nbuckets *= 2;
+	long *buckets = malloc(sizeof(long) * nbuckets);
+	for (size_t i = 0; i < nbuckets; i++)
+		buckets[i] = -1;
+	for (size_t i = 0; i < nblocks; i++)
+	{
+		size_t h = blocks[i].weak & (nbuckets - 1);
+		blocks[i].next = buckets[h];
+		buckets[h] = i;
+	}
+
+	// Single streaming pass over file2
+	struct delta_state d = {0};
+	size_t cap = block + (1 << 20);
+	buf = malloc(cap);
+	size_t have = input_read_full(&f2, buf, cap), pos = 0;
+	bool eof = have < cap;
+	bool rolling = false;
+	while (1)
+	{
+		if (have - pos <= block && !eof)    // Keep at least one byte past the window for rolling
+		{
+			memmove(buf, buf + pos, have - pos);
+			have -= pos;
+			pos = 0;
+			size_t n = input_read_full(&f2, buf + have, cap - have);
+			eof = n < cap - have;
+			have += n;
+		}
+		if (have - pos < block) break;
+
+		if (!rolling)
+		{
+			weak_checksum(buf + pos, block, &a, &b);
+			rolling = true;
+		}
+		uint32_t weak = a | (b << 16);
+		long match = -1;
+		bool have_strong = false;
+		uint64_t strong = 0;
+		for (long i = buckets[weak & (nbuckets - 1)]; i != -1; i = blocks[i].next)
+		{
+			if (blocks[i].weak != weak) continue;
+			if (!have_strong)
+			{
+				strong = fnv1a64(buf + pos, block);
+				have_strong = true;
+			}
+			if (blocks[i].strong != strong) continue;
+			match = i;
+			if (d.copy_len && d.literal == 0 && d.copy_off + d.copy_len == (unsigned long)i * block)
+				break;      // Prefer the block that extends the current copy
+		}
+		if (match != -1)
+		{
+			delta_copy(&d, (unsigned long)match * block, block);
+			blocks[match].used = true;
+			d.copied += block;
+			pos += block;
+			rolling = false;
+			continue;
+		}
+
+		d.literal++;
+		if (pos + block < have)
+		{
+			uint32_t out = buf[pos], in = buf[pos + block];
+			a = (a - out + in) & 0xffff;
+			b = (b - (uint32_t)block * out + a) & 0xffff;
+		}
+		else
+			rolling = false;
+		pos++;
+	}
+	size_t rest = have - pos;
+	if (rest > 0 && rest == tail_len && fnv1a64(buf + pos, rest) == tail_strong)
+	{
+		delta_copy(&d, (unsigned long)nblocks * block, rest);
+		d.copied += rest;
+		tail_len = 0;
+	}
+	else
+		d.literal += rest;
+	delta_flush_literal(&d);
+	if (d.copy_len)
+		printf("copy   %lu %lu\n", d.copy_off, d.copy_len);
+	input_close(&f2);
+	free(buf);
+	if (f2.error)
+	{
+		printf("-%s: kdiff: %s: %s\n", sysname, file2, strerror(f2.error));
+		free(blocks);
+		free(buckets);
+		return -1;
+	}
+
+	unsigned long removed = tail_len;   // Bytes of file1 no copy refers to
+	for (size_t i = 0; i < nblocks; i++)
+		if (!blocks[i].used)
+			removed += block;
+	free(blocks);
+	free(buckets);
+
+	if (d.inserted == 0 && removed == 0)
+		printf("The two files are identical and have %lu bytes\n", d.copied);
+	else
+		printf("%lu bytes changed: %lu inserted, %lu removed\n", d.inserted + removed, d.inserted, removed);
+	return 0;
+}
+/**
+ * Sends a whole file to stdout, with sendfile so the data never goes
+ * through user space
+ * @param fd  file to send, from offset 0
+ */
+void send_to_stdout(int fd)
+{
+	struct stat st;
+	off_t off = 0;
+	fflush(stdout);
+	if (fstat(fd, &st) == -1) return;
+	while (off < st.st_size)
+	{
+		ssize_t n = sendfile(STDOUT_FILENO, fd, &off, st.st_size - off);
+		if (n > 0) continue;
+		if (n == -1 && errno == EINTR) continue;
+		if (n == -1 && (errno == EINVAL || errno == ENOSYS))    // stdout does not support sendfile
+		{
+			char chunk[65536];
+			ssize_t r;
+			while ((r = pread(fd, chunk, sizeof(chunk), off)) > 0)
+			{
+				if (write(STDOUT_FILENO, chunk, r) != r) return;
+				off += r;
+			}
+		}
+		return;
+	}
+}
+/**
+ * Directory of the result cache, created if needed
+ * @return 0 on success, -1 if there is no usable cache directory
+ */
+int cache_dir(char *dir, size_t size)
+{
+	const char *base = getenv("XDG_CACHE_HOME");
+	char parent[1024];
+	if (base != NULL && base[0] != 0)
+		snprintf(parent, sizeof(parent), "%s", base);
+	else if (getenv("HOME") != NULL)
+		snprintf(parent, sizeof(parent), "%s/.cache", getenv("HOME"));
+	else
+		return -1;
+	mkdir(parent, 0700);
+	snprintf(dir, size, "%s/%s", parent, sysname);
+	if (mkdir(dir, 0700) == -1 && errno != EEXIST)
+		return -1;
+	return 0;
+}
+/**
+ * Cache key of a command: a hash of the working directory's device and inode,
+ * of its arguments and, for every argument naming an existing file, that
+ * file's device, inode, size and mtime. Any change to an input file, or
+ * running the command in another directory, therefore leads to a different key.
+ */
+uint64_t cache_key(char **args)
+{
+	uint64_t h = 14695981039346656037ULL;     // FNV-1a, as in fnv1a64()
+	struct stat cwd;
+	if (stat(".", &cwd) == 0)     // Relative arguments, and commands like ls, depend on it
+	{
+		uint64_t id[2] = { cwd.st_dev, cwd.st_ino };
+		h ^= fnv1a64((const unsigned char *)id, sizeof(id));
+		h *= 1099511628211ULL;
+	}
+	for (int i = 0; args[i] != NULL; i++)
+	{
+		struct stat st;
+		for (const char *c = args[i]; ; c++)    // Hash the argument with its NUL, so arguments cannot run together
+		{
+			h ^= (unsigned char)*c;
+			h *= 1099511628211ULL;
+			if (*c == 0) break;
+		}
+		if (stat(args[i], &st) == 0)
+		{
+			uint64_t meta[5] = { st.st_dev, st.st_ino, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec };
+			h ^= fnv1a64((const unsigned char *)meta, sizeof(meta));
+			h *= 1099511628211ULL;
+		}
+	}
+	return h;
+}
+/**
+ * Removes the least recently used entries until the cache fits in
+ * CACHE_MAX_BYTES. A hit refreshes the mtime of its entry, so mtime order
+ * is use order.
+ */
+void cache_evict(const char *dir)
+{
+	DIR *d = opendir(dir);
+	if (d == NULL) return;
+	struct cache_entry { char name[32]; time_t used; off_t size; } *entries = NULL;
+	size_t count = 0, cap = 0;
+	long total = 0;
+	struct dirent *de;
+	while ((de = readdir(d)) != NULL)
+	{
+		struct stat st;
+		if (strlen(de->d_name) != 16) continue;     // Only entries named by their key
+		if (fstatat(dirfd(d), de->d_name, &st, 0) == -1) continue;
+		if (count == cap)
+		{
+			cap = cap ? cap * 2 : 64;
+			entries = realloc(entries, sizeof(struct cache_entry) * cap);
+		}
+		strcpy(entries[count].name, de->d_name);
+		entries[count].used = st.st_mtime;
+		entries[count].size = st.st_size;
+		total += st.st_size;
+		count++;
+	}
+	while (total > CACHE_MAX_BYTES && count > 0)
+	{
+		size_t oldest = 0;
+		for (size_t i = 1; i < count; i++)
+			if (entries[i].used < entries[oldest].used)
+				oldest = i;
+		unlinkat(dirfd(d), entries[oldest].name, 0);
+		total -= entries[oldest].size;
+		entries[oldest] = entries[--count];
+	}
+	free(entries);
+	closedir(d);
+}
+/**
+ * Writes all of buf, retrying short writes
+ * @return 0 on success, -1 on error
+ */
+int write_full(int fd, const char *buf, size_t n)
+{
+	while (n > 0)
+	{
+		ssize_t w = write(fd, buf, n);
+		if (w == -1 && errno == EINTR) continue;
+		if (w <= 0) return -1;
+		buf += w;
+		n -= w;
+	}
+	return 0;
+}
+/**
+ * Exit handler of a command whose output is being cached: output that could
+ * not be written must not look like a successful run
+ */
+void cache_check_output()
+{
+	if (fflush(stdout) == EOF || ferror(stdout))
+		_exit(1);
+}
+/**
+ * Runs the rest of the child through the result cache.
+ * On a hit the stored output is sent to stdout and the child exits.
+ * On a miss the command runs in a new process with stdout going to a pipe.
+ * This process copies the output to stdout as it arrives and to a temporary
+ * file, and stores the file under the key if the command ran to its end and
+ * succeeded, and every write to the file worked. cache_run returns only in
+ * that new process, which goes on to run the command, or when there is no
+ * usable cache. A child that returns from process_command instead of
+ * finishing exits non-zero, so it is never stored.
+ */
+void cache_run(char **args)
+{
+	char dir[1024], entry[1100], temp[1100];
+	if (cache_dir(dir, sizeof(dir)) == -1) return;
+	snprintf(entry, sizeof(entry), "%s/%016llx", dir, (unsigned long long)cache_key(args));
+
+	int fd = open(entry, O_RDONLY);
+	if (fd != -1)   // Hit
+	{
+		utimensat(AT_FDCWD, entry, NULL, 0);    // Mark as recently used
+		send_to_stdout(fd);
+		close(fd);
+		exit(0);
+	}
+
+	snprintf(temp, sizeof(temp), "%s/tmp.XXXXXX", dir);
+	fd = mkstemp(temp);
+	if (fd == -1) return;
+	int p[2];
+	if (pipe(p) == -1)
+	{
+		close(fd);
+		unlink(temp);
+		return;
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fd);
+		close(p[READ_END]);
+		dup2(p[WRITE_END], STDOUT_FILENO);
+		close(p[WRITE_END]);
+		atexit(cache_check_output);
+		return;
+	}
+	close(p[WRITE_END]);
+	bool complete = pid > 0;    // The temporary file holds all of the output
+	bool out_ok = true;
+	char buf[65536];
+	ssize_t n;
+	while (pid > 0 && (n = read(p[READ_END], buf, sizeof(buf))) != 0)
+	{
+		if (n == -1 && errno == EINTR) continue;
+		if (n == -1)
+		{
+			complete = false;
+			break;
+		}
+		if (out_ok && write_full(STDOUT_FILENO, buf, n) == -1)
+			out_ok = false;     // Keep reading, so the command is not stopped halfway
+		if (complete && write_full(fd, buf, n) == -1)
+			complete = false;
+	}
+	close(p[READ_END]);
+	int status = 1;
+	if (pid > 0)
+		waitpid(pid, &status, 0);
+	if (close(fd) == -1)
+		complete = false;
+	if (complete && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+	{
+		rename(temp, entry);
+		cache_evict(dir);
+	}
+	else
+		unlink(temp);
+	exit(pid > 0 && WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+}
+/**
+ * Cache of $PATH lookups, kept for the life of the shell so that repeated
+ * commands do not scan every $PATH directory. Cleared when $PATH changes.
+ */
+#define PATH_CACHE_SIZE 256
+
+struct path_cache_entry {
+	char *name;
+	char *location;
+};
+struct path_cache_entry path_cache[PATH_CACHE_SIZE];
+char *path_cache_path = NULL;      // $PATH the cache was filled with
+/**
+ * Finds the executable for a command name, the first match in $PATH wins
+ * @return location of the executable, owned by the cache, or NULL
+ */
+const char *resolve_command(const char *name)
+{
+	if (strchr(name, '/') != NULL)
+		return access(name, X_OK) == 0 ? name : NULL;
+	const char *env = getenv("PATH");
+	if (env == NULL) return NULL;
+	if (path_cache_path == NULL || strcmp(path_cache_path, env) != 0)
+	{
+		for (int i = 0; i < PATH_CACHE_SIZE; i++)
+		{
+			free(path_cache[i].name);
+			free(path_cache[i].location);
+			path_cache[i].name = path_cache[i].location = NULL;
+		}
+		free(path_cache_path);
+		path_cache_path = strdup(env);
+	}
+
+	size_t slot = fnv1a64((const unsigned char *)name, strlen(name)) % PATH_CACHE_SIZE;
+	if (path_cache[slot].name != NULL && strcmp(path_cache[slot].name, name) == 0
+			&& access(path_cache[slot].location, X_OK) == 0)
+		return path_cache[slot].location;
+
+	char *path = strdup(env);
+	char *location = NULL;
+	for (char *tok = strtok(path, WHICH_DELIMITER); tok != NULL; tok = strtok(NULL, WHICH_DELIMITER))  // Tokenize environment paths with ":"
+	{
+		char *file = malloc(strlen(tok) + 2 + strlen(name));
+		sprintf(file, "%s/%s", tok, name);     // Desired format for wanted command
+		if (access(file, X_OK) == 0)
+		{
+			location = file;
+			break;
+		}
+		free(file);
+	}
+	free(path);
+	if (location == NULL) return NULL;
+
+	free(path_cache[slot].name);        // One entry per slot, a collision replaces the older name
+	free(path_cache[slot].location);
+	path_cache[slot].name = strdup(name);
+	path_cache[slot].location = location;
+	return location;
+}
+bool is_builtin(const char *name)
+{
+	const char *builtins[] = { "shortdir", "highlight", "goodMorning", "kdiff", "zoom", "cache", NULL };
+	for (int i = 0; builtins[i] != NULL; i++)
+		if (strcmp(name, builtins[i]) == 0)
+			return true;
+	return false;
+}
+/**
+ * Directories visited with cd and shortdir jump, ranked by frecency: the
+ * visit count weighted by how recently the directory was last visited.
+ * The index is kept in memory by the shell (jump children inherit it) and
+ * persisted as an append-only log of "count time path" lines, which is
+ * folded back into one line per directory when it has grown too long.
+ */
+struct dir_visit {
+	char *path;
+	char *lower;        // lower case path, for matching
+	unsigned long count;
+	time_t last;
+};
+struct visit_index {
+	struct dir_visit *dirs;
+	size_t count, cap;
+	long *table;        // open addressing hash of paths to dirs
+	size_t table_size;
+	size_t log_lines;   // lines in the log file
+	bool loaded;
+	struct stat log;    // the log file as it was read, to notice writes by other processes
+} visits;
+
+long visits_find(const char *path)
+{
+	if (visits.table_size == 0) return -1;
+	size_t slot = fnv1a64((const unsigned char *)path, strlen(path)) & (visits.table_size - 1);
+	for (; visits.table[slot] != -1; slot = (slot + 1) & (visits.table_size - 1))
+		if (strcmp(visits.dirs[visits.table[slot]].path, path) == 0)
+			return visits.table[slot];
+	return -1;
+}
+/**
+ * Finds the entry of a directory, adding an unvisited one if needed
+ */
+struct dir_visit *visits_entry(const char *path)
+{
+	long i = visits_find(path);
+	if (i != -1) return &visits.dirs[i];
+	if (visits.count == visits.cap)
+	{
+		visits.cap = visits.cap ? visits.cap * 2 : 256;
+		visits.dirs = realloc(visits.dirs, sizeof(struct dir_visit) * visits.cap);
+	}
+	if ((visits.count + 1) * 2 > visits.table_size)     // Keep the table at most half full
+	{
+		free(visits.table);
+		visits.table_size = visits.table_size ? visits.table_size * 2 : 512;
+		visits.table = malloc(sizeof(long) * visits.table_size);
+		for (size_t j = 0; j < visits.table_size; j++)
+			visits.table[j] = -1;
+		for (size_t j = 0; j < visits.count; j++)
+		{
+			size_t slot = fnv1a64((const unsigned char *)visits.dirs[j].path, strlen(visits.dirs[j].path)) & (visits.table_size - 1);
+			while (visits.table[slot] != -1)
+				slot = (slot + 1) & (visits.table_size - 1);
+			visits.table[slot] = j;
+		}
+	}
+	struct dir_visit *v = &visits.dirs[visits.count];
+	v->path = strdup(path);
+	v->lower = strdup(path);
+	for (char *c = v->lower; *c; c++)
+		*c = tolower((unsigned char)*c);
+	v->count = 0;
+	v->last = 0;
+	size_t slot = fnv1a64((const unsigned char *)path, strlen(path)) & (visits.table_size - 1);
+	while (visits.table[slot] != -1)
+		slot = (slot + 1) & (visits.table_size - 1);
+	visits.table[slot] = visits.count;
+	visits.count++;
+	return v;
+}
+/**
+ * Notes the current state of the log file, after reading or writing it
+ */
+void visits_stat_log()
+{
+	if (stat(SHORTDIR_VISITS_FILE, &visits.log) == -1)
+		memset(&visits.log, 0, sizeof(visits.log));
+}
+/**
+ * Reads the visit log, again only if another process (e.g. a server worker)
+ * has written it since, then compacts it if it holds many more lines than
+ * directories
+ */
+void visits_load()
+{
+	struct stat old = visits.log;
+	visits_stat_log();
+	if (visits.loaded && old.st_ino == visits.log.st_ino && old.st_size == visits.log.st_size
+			&& old.st_mtim.tv_sec == visits.log.st_mtim.tv_sec && old.st_mtim.tv_nsec == visits.log.st_mtim.tv_nsec)
+		return;
+	for (size_t i = 0; i < visits.count; i++)     // Changed, start over
+	{
+		free(visits.dirs[i].path);
+		free(visits.dirs[i].lower);
+	}
+	for (size_t i = 0; i < visits.table_size; i++)
+		visits.table[i] = -1;
+	visits.count = visits.log_lines = 0;
+	visits.loaded = true;
+	struct line_reader r;
+	if (line_reader_open(&r, SHORTDIR_VISITS_FILE) == -1) return;
+	const char *line;
+	size_t len;
+	while ((line = line_reader_next(&r, &len)) != NULL)
+	{
+		char *entry = strndup(line, len), *path;
+		entry[strcspn(entry, "\n")] = 0;
+		unsigned long count = strtoul(entry, &path, 10);
+		time_t last = strtol(path, &path, 10);
+		if (*path == ' ' && path[1] == '/')
+		{
+			struct dir_visit *v = visits_entry(path + 1);
+			v->count += count;
+			if (last > v->last) v->last = last;
+		}
+		free(entry);
+		visits.log_lines++;
+	}
+	line_reader_close(&r);
+
+	if (visits.log_lines > visits.count * 2 + 1000)
+	{
+		FILE *ftemp = fopen(SHORTDIR_VISITS_TEMP_FILE, "w");
+		if (ftemp == NULL) return;
+		for (size_t i = 0; i < visits.count; i++)
+			fprintf(ftemp, "%lu %ld %s\n", visits.dirs[i].count, (long)visits.dirs[i].last, visits.dirs[i].path);
+		fclose(ftemp);
+		rename(SHORTDIR_VISITS_TEMP_FILE, SHORTDIR_VISITS_FILE);
+		visits.log_lines = visits.count;
+		visits_stat_log();
+	}
+}
+/**
+ * Records a visit to the current directory
+ */
+void visits_add_cwd()
+{
+	char cwd[1024];
+	if (getcwd(cwd, sizeof(cwd)) == NULL) return;
+	visits_load();
+	struct dir_visit *v = visits_entry(cwd);
+	v->count++;
+	v->last = time(NULL);
+	FILE *flog = fopen(SHORTDIR_VISITS_FILE, "a");
+	if (flog == NULL) return;
+	fprintf(flog, "1 %ld %s\n", (long)v->last, cwd);
+	fclose(flog);
+	visits.log_lines++;
+	visits_stat_log();
+}
+/**
+ * Visit count weighted by the time since the last visit
+ */
+double frecency(const struct dir_visit *v, time_t now)
+{
+	time_t age = now - v->last;
+	if (age < 3600) return v->count * 4.0;
+	if (age < 86400) return v->count * 2.0;
+	if (age < 7 * 86400) return v->count * 0.5;
+	return v->count * 0.25;
+}
+/**
+ * Scores text as a fuzzy match of query: query must be a subsequence of text.
+ * Matching runs from the end, so the last path component is preferred, and
+ * consecutive characters or characters starting a word score higher.
+ * @param query  lower case query
+ * @param text   lower case text
+ * @return       0 if it does not match
+ */
+int fuzzy_score(const char *query, const char *text)
+{
+	size_t q = strlen(query), t = strlen(text);
+	if (q == 0 || q > t) return 0;
+	size_t last_slash = t;
+	while (last_slash > 0 && text[last_slash-1] != '/') last_slash--;
+	int score = 0;
+	size_t prev = t;
+	while (q > 0)
+	{
+		q--;
+		while (t > 0 && text[t-1] != query[q]) t--;
+		if (t == 0) return 0;
+		t--;
+		score += 1;
+		if (prev == t + 1) score += 4;      // Next to the following match
+		if (t == 0 || strchr("/-_. ", text[t-1])) score += 6;   // Starts a word
+		if (t >= last_slash) score += 2;    // In the last component
+		prev = t;
+	}
+	return score;
+}
+/**
+ * Picks the directory shortdir jump goes to: the alias with exactly this
+ * name if there is one, otherwise the best fuzzy match among alias names and
+ * visited directories, ranked by match score times frecency
+ * @return the path, or NULL if nothing matches
+ */
+char *shortdir_target(const char *name)
+{
+	char *path = NULL, *best = NULL;
+	double best_rank = 0;
+	time_t now = time(NULL);
+	char *query = strdup(name);
+	for (char *c = query; *c; c++)
+		*c = tolower((unsigned char)*c);
+
+	struct line_reader reader;
+	if (alias_table.data != NULL)
+	{
+		line_reader_memory(&reader, alias_table.data, alias_table.len);
+		const char *line;
+		size_t len;
+		while ((line = line_reader_next(&reader, &len)) != NULL)
+		{
+			const char *colon = memchr(line, ':', len);
+			if (colon == NULL) continue;
+			char *alias = strndup(line, colon - line);
+			char *target = strndup(colon + 1, len - (colon + 1 - line));
+			target[strcspn(target, "\n")] = 0;
+			if (strcmp(alias, name) == 0)       // Exact alias, the last one set wins
+			{
+				free(path);
+				path = strdup(target);
+			}
+			else if (path == NULL)
+			{
+				for (char *c = alias; *c; c++)
+					*c = tolower((unsigned char)*c);
+				long v = visits_find(target);
+				double rank = fuzzy_score(query, alias) * 2.0 * (1 + (v == -1 ? 0 : frecency(&visits.dirs[v], now)));
+				if (rank > best_rank && access(target, X_OK) == 0)
+				{
+					best_rank = rank;
+					free(best);
+					best = strdup(target);
+				}
+			}
+			free(alias);
+			free(target);
+		}
+		line_reader_close(&reader);
+	}
+	if (path != NULL)
+	{
+		free(best);
+		free(query);
+		return path;
+	}
+
+	for (size_t i = 0; i < visits.count; i++)
+	{
+		struct dir_visit *v = &visits.dirs[i];
+		int score = fuzzy_score(query, v->lower);
+		if (score == 0) continue;
+		double rank = score * (1 + frecency(v, now));
+		if (rank > best_rank && access(v->path, X_OK) == 0)     // Only check directories that would win
+		{
+			best_rank = rank;
+			free(best);
+			best = strdup(v->path);
+		}
+	}
+	free(query);
+	return best;
+}
+/**
+ * Appends n bytes of s to the growing string *out
+ */
+void append_str(char **out, size_t *len, size_t *cap, const char *s, size_t n)
+{
+	if (*len + n + 1 > *cap)
+	{
+		while (*len + n + 1 > *cap)
+			*cap *= 2;
+		*out = realloc(*out, *cap);
+	}
+	memcpy(*out + *len, s, n);
+	*len += n;
+	(*out)[*len] = 0;
+}
+/**
+ * Expands $NAME, ${NAME} and $? in a word, and a leading ~ or ~user
+ * @param  tilde  whether to expand a leading ~
+ * @return        the expanded word, to be freed by the caller
+ */
+char *expand_word(const char *word, bool tilde)
+{
+	size_t len = 0, cap = strlen(word) + 64;
+	char *out = malloc(cap);
+	const char *p = word;
+	out[0] = 0;
+	if (tilde && *p == '~')
+	{
+		const char *end = p + 1 + strcspn(p + 1, "/");
+		const char *home = NULL;
+		if (end == p + 1)
+			home = getenv("HOME");
+		else
+		{
+			char *user = strndup(p + 1, end - p - 1);
+			struct passwd *pw = getpwnam(user);
+			free(user);
+			if (pw != NULL) home = pw->pw_dir;
+		}
+		if (home != NULL)
+		{
+			append_str(&out, &len, &cap, home, strlen(home));
+			p = end;
+		}
+	}
+	while (*p)
+	{
+		if (p[0] == '$' && p[1] == '?')     // Exit status of the last command
+		{
+			char status[16];
+			snprintf(status, sizeof(status), "%d", last_status);
+			append_str(&out, &len, &cap, status, strlen(status));
+			p += 2;
+			continue;
+		}
+		const char *name = NULL, *next = NULL;
+		if (p[0] == '$' && p[1] == '{' && strchr(p + 2, '}') != NULL)
+		{
+			name = p + 2;
+			next = strchr(p + 2, '}') + 1;
+		}
+		else if (p[0] == '$' && (isalpha((unsigned char)p[1]) || p[1] == '_'))
+		{
+			name = p + 1;
+			for (next = name; isalnum((unsigned char)*next) || *next == '_'; next++);
+		}
+		if (name == NULL)
+		{
+			append_str(&out, &len, &cap, p++, 1);
+			continue;
+		}
+		char *var = strndup(name, next - name - (*(next - 1) == '}'));
+		const char *value = getenv(var);
+		if (value != NULL)      // Unset variables expand to nothing
+			append_str(&out, &len, &cap, value, strlen(value));
+		free(var);
+		p = next;
+	}
+	return out;
+}
+/**
+ * Directory listings for glob expansion, cached per directory (by device and
+ * inode, as relative paths name other directories after cd) while the
+ * directory's mtime stays the same, so repeated and overlapping globs do
+ * not read a directory again. Listings are read with getdents64 in large
+ * batches. Above DIR_CACHE_SIZE directories the least recently used
+ * listing that no walk is reading is dropped.
+ */
+#define DIR_CACHE_SIZE 4096
+
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+struct dir_listing {
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+	char **names;
+	unsigned char *types;   // d_type of each name, never DT_UNKNOWN
+	size_t count;
+	char *block;            // storage of the names
+	struct dir_listing *newer, *older;  // use order
+	int pins;               // walks iterating over the listing, which keep it cached
+};
+struct dir_listing *dir_cache[DIR_CACHE_SIZE * 2];     // open addressing on device and inode
+size_t dir_cache_count = 0;
+struct dir_listing *dir_newest = NULL, *dir_oldest = NULL;
+
+void dir_listing_free(struct dir_listing *l)
+{
+	free(l->names);
+	free(l->types);
+	free(l->block);
+	free(l);
+}
+/**
+ * Reads a directory into a listing
+ * @return the listing, or NULL if path is not a readable directory
+ */
+struct dir_listing *dir_read(const char *path, const struct stat *st)
+{
+	int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1) return NULL;
+	struct dir_listing *l = calloc(1, sizeof(struct dir_listing));
+	size_t used = 0, size = 4096, cap = 0;
+	size_t *offsets = NULL;
+	l->block = malloc(size);
+	char *buf = malloc(65536);
+	long n;
+	while ((n = syscall(SYS_getdents64, fd, buf, 65536)) > 0)
+	{
+		for (long off = 0; off < n; )
+		{
+			struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+			off += d->d_reclen;
+			if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+			size_t name_len = strlen(d->d_name) + 1;
+			if (used + name_len > size)
+			{
+				while (used + name_len > size) size *= 2;
+				l->block = realloc(l->block, size);
+			}
+			if (l->count == cap)
+			{
+				cap = cap ? cap * 2 : 64;
+				offsets = realloc(offsets, sizeof(size_t) * cap);
+				l->types = realloc(l->types, cap);
+			}
+			unsigned char type = d->d_type;
+			struct stat st;
+			if (type == DT_UNKNOWN && fstatat(fd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0)   // File systems without d_type
+				type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+			memcpy(l->block + used, d->d_name, name_len);
+			offsets[l->count] = used;
+			l->types[l->count++] = type;
+			used += name_len;
+		}
+	}
+	free(buf);
+	close(fd);
+	l->names = malloc(sizeof(char *) * (l->count ? l->count : 1));
+	for (size_t i = 0; i < l->count; i++)
+		l->names[i] = l->block + offsets[i];
+	free(offsets);
+	l->dev = st->st_dev;
+	l->ino = st->st_ino;
+	l->mtime = st->st_mtim;
+	return l;
+}
+size_t dir_cache_home(dev_t dev, ino_t ino)
+{
+	uint64_t id[2] = { dev, ino };
+	return fnv1a64((const unsigned char *)id, sizeof(id)) % (DIR_CACHE_SIZE * 2);
+}
+void dir_lru_unlink(struct dir_listing *l)
+{
+	if (l->newer) l->newer->older = l->older;
+	else dir_newest = l->older;
+	if (l->older) l->older->newer = l->newer;
+	else dir_oldest = l->newer;
+}
+void dir_lru_push(struct dir_listing *l)
+{
+	l->older = dir_newest;
+	l->newer = NULL;
+	if (dir_newest) dir_newest->newer = l;
+	else dir_oldest = l;
+	dir_newest = l;
+}
+/**
+ * Drops the least recently used listing that is not pinned, closing the gap
+ * in the table by moving later entries of the probe sequence back
+ */
+void dir_cache_evict()
+{
+	struct dir_listing *l = dir_oldest;
+	while (l != NULL && l->pins > 0)
+		l = l->newer;
+	if (l == NULL) return;
+	size_t size = DIR_CACHE_SIZE * 2;
+	size_t i = dir_cache_home(l->dev, l->ino);
+	while (dir_cache[i] != l)
+		i = (i + 1) % size;
+	for (size_t j = (i + 1) % size; dir_cache[j] != NULL; j = (j + 1) % size)
+	{
+		size_t home = dir_cache_home(dir_cache[j]->dev, dir_cache[j]->ino);
+		if (i <= j ? (home <= i || home > j) : (home <= i && home > j))     // Entry j may move to i
+		{
+			dir_cache[i] = dir_cache[j];
+			i = j;
+		}
+	}
+	dir_cache[i] = NULL;
+	dir_lru_unlink(l);
+	dir_listing_free(l);
+	dir_cache_count--;
+}
+/**
+ * Returns the listing of a directory, from the cache if it is up to date
+ */
+struct dir_listing *dir_cache_get(const char *path)
+{
+	struct stat st;
+	if (stat(path, &st) == -1 || !S_ISDIR(st.st_mode)) return NULL;
+	size_t slot = dir_cache_home(st.st_dev, st.st_ino);
+	for (; dir_cache[slot] != NULL; slot = (slot + 1) % (DIR_CACHE_SIZE * 2))
+	{
+		struct dir_listing *l = dir_cache[slot];
+		if (l->dev != st.st_dev || l->ino != st.st_ino) continue;
+		dir_lru_unlink(l);
+		if ((l->mtime.tv_sec == st.st_mtim.tv_sec && l->mtime.tv_nsec == st.st_mtim.tv_nsec)
+				|| l->pins > 0)     // A walk below it still reads this one
+		{
+			dir_lru_push(l);
+			return l;
+		}
+		struct dir_listing *fresh = dir_read(path, &st);    // Changed since it was cached
+		if (fresh == NULL)
+		{
+			dir_lru_push(l);
+			return NULL;
+		}
+		dir_listing_free(l);
+		dir_cache[slot] = fresh;
+		dir_lru_push(fresh);
+		return fresh;
+	}
+	struct dir_listing *l = dir_read(path, &st);
+	if (l == NULL) return NULL;
+	if (dir_cache_count >= DIR_CACHE_SIZE)
+	{
+		dir_cache_evict();
+		slot = dir_cache_home(st.st_dev, st.st_ino);    // Eviction may have moved entries
+		while (dir_cache[slot] != NULL)
+			slot = (slot + 1) % (DIR_CACHE_SIZE * 2);
+	}
+	dir_cache[slot] = l;
+	dir_lru_push(l);
+	dir_cache_count++;
+	return l;
+}
+bool has_glob(const char *word)
+{
+	return strpbrk(word, "*?[") != NULL;
+}
+struct glob_result {
+	char **paths;
+	size_t count, cap;
+	bool dirs_only;     // the pattern ended with /
+};
+void glob_add(struct glob_result *g, const char *path)
+{
+	if (g->dirs_only)
+	{
+		struct stat st;
+		if (stat(path, &st) == -1 || !S_ISDIR(st.st_mode)) return;
+	}
+	if (g->count == g->cap)
+	{
+		g->cap = g->cap ? g->cap * 2 : 16;
+		g->paths = realloc(g->paths, sizeof(char *) * g->cap);
+	}
+	size_t len = strlen(path);
+	g->paths[g->count] = malloc(len + 2);
+	strcpy(g->paths[g->count], path);
+	if (g->dirs_only) strcat(g->paths[g->count], "/");
+	g->count++;
+}
+char *glob_join(const char *dir, const char *name)
+{
+	size_t len = strlen(dir);
+	char *path = malloc(len + strlen(name) + 2);
+	if (len == 0)
+		strcpy(path, name);
+	else
+		sprintf(path, dir[len-1] == '/' ? "%s%s" : "%s/%s", dir, name);
+	return path;
+}
+/**
+ * Matches the pattern segments from i on below dir and collects the paths
+ * @param dir  path matched so far, "" for the current directory
+ */
+void glob_walk(const char *dir, char **segments, int count, int i, struct glob_result *g)
+{
+	const char *seg = segments[i];
+	bool last = i == count - 1;
+	if (!has_glob(seg))     // Literal component, no need to read the directory
+	{
+		char *path = glob_join(dir, seg);
+		struct stat st;
+		if (!last)
+			glob_walk(path, segments, count, i + 1, g);
+		else if (lstat(path, &st) == 0)
+			glob_add(g, path);
+		free(path);
+		return;
+	}
+	bool recursive = strcmp(seg, "**") == 0;
+	if (recursive && !last)
+		glob_walk(dir, segments, count, i + 1, g);      // ** matching no directory at all
+	struct dir_listing *l = dir_cache_get(dir[0] ? dir : ".");
+	if (l == NULL) return;
+	l->pins++;      // Keeps it while the walk below may fill the cache
+	for (size_t j = 0; j < l->count; j++)
+	{
+		const char *name = l->names[j];
+		unsigned char type = l->types[j];
+		if (recursive ? name[0] == '.' : fnmatch(seg, name, FNM_PERIOD) != 0)
+			continue;
+		char *path = glob_join(dir, name);
+		if (last)
+			glob_add(g, path);
+		if (recursive && type == DT_DIR)        // ** does not follow symlinks
+			glob_walk(path, segments, count, i, g);
+		else if (!recursive && !last && (type == DT_DIR || type == DT_LNK))
+			glob_walk(path, segments, count, i + 1, g);
+		free(path);
+	}
+	l->pins--;
+}
+int string_compare(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+/**
+ * Expands a glob pattern with *, ?, [...] and ** (any number of directories)
+ * @param  matches  set to the sorted matching paths, to be freed by the caller
+ * @return          number of matches
+ */
+int expand_glob(const char *pattern, char ***matches)
+{
+	struct glob_result g = {0};
+	char *copy = strdup(pattern);
+	size_t len = strlen(copy);
+	while (len > 1 && copy[len-1] == '/')
+	{
+		copy[--len] = 0;
+		g.dirs_only = true;
+	}
+	char **segments = malloc(sizeof(char *) * (len / 2 + 2));
+	int count = 0;
+	for (char *seg = copy; *seg; )     // Split at /, not with strtok: parse_command is in the middle of one
+	{
+		char *end = seg + strcspn(seg, "/");
+		if (end > seg)
+			segments[count++] = seg;
+		if (*end == 0) break;
+		*end = 0;
+		seg = end + 1;
+	}
+	if (count > 0)
+		glob_walk(pattern[0] == '/' ? "/" : "", segments, count, 0, &g);
+	free(segments);
+	free(copy);
+	qsort(g.paths, g.count, sizeof(char *), string_compare);
+	*matches = g.paths;
+	return g.count;
+}
+/**
+ * Whether a highlight command line asks for -f, whose output is never cached
+ */
+bool highlight_follows(char **args)
+{
+	for (int i = 1; args[i] != NULL && (strcmp(args[i], "-f") == 0 || strcmp(args[i], "-e") == 0); i++)
+		if (strcmp(args[i], "-f") == 0)
+			return true;
+	return false;
+}
+int process_command(struct command_t *command);
+/**
+ * Loads what the child of a command will read into the shell process before
+ * the fork, so the child gets it and later commands reuse it: the PATH
+ * lookup, and the visit index and alias or zoom lists
+ */
+void prepare_command(struct command_t *command)
+{
+	if (!is_builtin(command->name))
+		resolve_command(command->name);
+	if (strcmp(command->name, "shortdir")==0)
+	{
+		visits_load();
+		list_table_load(&alias_table);
+	}
+	if (strcmp(command->name, "zoom")==0)
+		list_table_load(&zoom_table);
+}
+/**
+ * Runs one request in a worker process forked by the server for it, with the
+ * client's stdin, stdout and stderr, then sends the reply and exits. If the
+ * client goes away first, the worker and its command are stopped.
+ * @param cwd_error  errno of changing to the client's directory, 0 if it worked
+ * @param command    command to run, NULL for an empty line
+ */
+void serve_request(int cfd, int fds[3], const char *cwd, int cwd_error, struct command_t *command)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		dup2(fds[i], i);
+		close(fds[i]);
+	}
+	setpgid(0, 0);      // The worker and its command form a group the watcher can stop
+	pid_t watcher = fork();
+	if (watcher == 0)
+	{
+		struct pollfd p = { cfd, POLLIN, 0 };     // The client sends nothing more, so this means it hung up
+		while (poll(&p, 1, -1) == -1 && errno == EINTR)
+			;
+		kill(0, SIGTERM);
+		_exit(0);
+	}
+	last_status = 0;
+	if (cwd_error)
+	{
+		printf("-%s: %s: %s\n", sysname, cwd, strerror(cwd_error));
+		last_status = 1;
+	}
+	else if (command != NULL)
+	{
+		process_command(command);
+		if (command_child)
+			exit(1);    // Never let a command's child reply
+	}
+	if (watcher > 0)
+	{
+		kill(watcher, SIGKILL);
+		waitpid(watcher, NULL, 0);
+	}
+	fflush(stdout);
+	fflush(stderr);
+	send(cfd, &last_status, sizeof(last_status), MSG_NOSIGNAL);     // The client may be gone
+	exit(0);
+}
+/**
+ * seashell --server SOCKET: one long running shell that executes command
+ * lines sent by clients over a Unix socket, so the PATH cache and other
+ * state stay warm and no terminal is set up. Each request carries the
+ * client's working directory and command line, plus the client's stdin,
+ * stdout and stderr passed as file descriptors, which the command uses
+ * directly. The reply is the command's exit status. "exit" stops the server.
+ * The server loads what a command needs (see prepare_command), then forks a
+ * worker that runs it, so the state stays warm in the server while a long or
+ * never ending command, such as highlight -f, does not hold up other clients.
+ */
+int run_server(const char *socket_path)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(socket_path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "-%s: socket path too long\n", sysname);
+		return 1;
+	}
+	strcpy(addr.sun_path, socket_path);
+
+	int sfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	unlink(socket_path);
+	mode_t mask = umask(077);     // Commands run as this user, so only this user may connect
+	int r = sfd == -1 ? -1 : bind(sfd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(mask);
+	if (r == -1 || listen(sfd, 128) == -1)
+	{
+		fprintf(stderr, "-%s: %s: %s\n", sysname, socket_path, strerror(errno));
+		return 1;
+	}
+	bool stop = false;
+	while (!stop)
+	{
+		while (waitpid(-1, NULL, WNOHANG) > 0)     // Reap the workers that are done
+			;
+		int cfd = accept(sfd, NULL, NULL);
+		if (cfd == -1)
+		{
+			if (errno == EINTR) continue;
+			break;
+		}
+		fcntl(cfd, F_SETFD, FD_CLOEXEC);
+
+		char buf[PATH_MAX + 4096 + 1];     // cwd and command line, as sent by client_send
+		char control[CMSG_SPACE(3 * sizeof(int))];
+		struct iovec iov = { buf, sizeof(buf) - 1 };
+		struct msghdr msg = {0};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		ssize_t n = recvmsg(cfd, &msg, MSG_CMSG_CLOEXEC);
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		if (n <= 0 || cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS
+				|| cmsg->cmsg_len != CMSG_LEN(3 * sizeof(int)))
+		{
+			close(cfd);
+			continue;
+		}
+		int fds[3];
+		memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+		if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))   // Never run a cut off directory or command line
+		{
+			int status = 1;
+			send(cfd, &status, sizeof(status), MSG_NOSIGNAL);
+			for (int i = 0; i < 3; i++)
+				close(fds[i]);
+			close(cfd);
+			continue;
+		}
+		buf[n] = 0;
+		char *cwd = buf;
+		char *line = buf + strlen(buf) + 1;
+		if (line >= buf + n) line = buf + n;     // No command line, nothing to run
+
+		struct command_t *command = NULL;
+		int cwd_error = chdir(cwd) == -1 ? errno : 0;    // Relative paths of the command, e.g. the zoom list, are the client's
+		if (cwd_error == 0 && strspn(line, " \t") != strlen(line))
+		{
+			command=malloc(sizeof(struct command_t));
+			memset(command, 0, sizeof(struct command_t)); // set all bytes to 0
+			parse_command(line, command);
+			stop = strcmp(command->name, "exit") == 0;
+			if (!stop)
+				prepare_command(command);
+		}
+		fflush(stdout);
+		fflush(stderr);
+		pid_t worker = stop ? -1 : fork();
+		if (worker == 0)
+		{
+			close(sfd);
+			serve_request(cfd, fds, cwd, cwd_error, command);
+		}
+		if (stop || worker == -1)
+		{
+			int status = stop ? 0 : 1;
+			send(cfd, &status, sizeof(status), MSG_NOSIGNAL);
+		}
+		for (int i = 0; i < 3; i++)
+			close(fds[i]);
+		close(cfd);
+		if (command != NULL)
+			free_command(command);
+	}
+	close(sfd);
+	unlink(socket_path);
+	return 0;
+}
+/**
+ * Sends one command line to a server started with --server and waits for it
+ * to finish. The command reads and writes this process's stdin, stdout and
+ * stderr, which are passed to the server.
+ * @return exit status of the command, or 1 if the server cannot be reached
+ */
+int client_send(const char *socket_path, const char *line)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+	int sfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (sfd == -1 || connect(sfd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+	{
+		fprintf(stderr, "-%s: %s: %s\n", sysname, socket_path, strerror(errno));
+		if (sfd != -1) close(sfd);
+		return 1;
+	}
+
+	char buf[PATH_MAX + 4096];
+	if (getcwd(buf, PATH_MAX) == NULL)
+	{
+		fprintf(stderr, "-%s: getcwd: %s\n", sysname, strerror(errno));
+		close(sfd);
+		return 1;
+	}
+	size_t len = strlen(buf) + 1;
+	snprintf(buf + len, sizeof(buf) - len, "%s", line);
+	len += strlen(buf + len) + 1;
+
+	int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	struct iovec iov = { buf, len };
+	struct msghdr msg = {0};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	int status = 1;
+	if (sendmsg(sfd, &msg, MSG_NOSIGNAL) == -1 || recv(sfd, &status, sizeof(status), 0) != sizeof(status))
+		status = 1;
+	close(sfd);
+	return status;
+}
+/**
+ * seashell --client SOCKET [COMMAND...]: runs the command given on the
+ * command line, or every line of stdin, on the server
+ */
+int run_client(const char *socket_path, int argc, char **argv)
+{
+	if (argc > 0)
+	{
+		char line[4096] = "";
+		for (int i = 0; i < argc; i++)
+		{
+			if (i > 0) strncat(line, " ", sizeof(line) - strlen(line) - 1);
+			strncat(line, argv[i], sizeof(line) - strlen(line) - 1);
+		}
+		return client_send(socket_path, line);
+	}
+	char line[4096];
+	int status = 0;
+	while (fgets(line, sizeof(line), stdin) != NULL)
+	{
+		line[strcspn(line, "\n")] = 0;
+		if (line[0] != 0)
+			status = client_send(socket_path, line);
+	}
+	return status;
+}
+int main(int argc, char *argv[])
+{
+	if (argc == 3 && strcmp(argv[1], "--server") == 0)
+		return run_server(argv[2]);
+	if (argc >= 3 && strcmp(argv[1], "--client") == 0)
+		return run_client(argv[2], argc - 3, argv + 3);
+
+	// Children share the stdin offset and may reset it when they exit, so
+	// read no further than the current command
+	setvbuf(stdin, NULL, _IONBF, 0);
+	while (1)
+	{
+		struct command_t *command=malloc(sizeof(struct command_t));
+		memset(command, 0, sizeof(struct command_t)); // set all bytes to 0
+
+		int code;
+		code = prompt(command);
+		if (code==EXIT) break;
+
+		code = process_command(command);
+		if (command_child)
+			exit(1);    // A command that returned instead of exiting must not become a second shell
+		if (code==EXIT) break;
+
+		free_command(command);
+	}
+
+	printf("\n");
+	return 0;
+}
+
+int process_command(struct command_t *command)
+{
+	int r;
+	if (strcmp(command->name, "")==0) return SUCCESS;
+
+	if (strcmp(command->name, "exit")==0)
+		return EXIT;
+
+	if (strcmp(command->name, "cd")==0)
+	{
+		if (command->arg_count > 0)
+		{
+			r=chdir(command->args[0]);
+			last_status = r==-1;
+			if (r==-1)
+				printf("-%s: %s: %s\n", sysname, command->name, strerror(errno));
+			else
+				visits_add_cwd();
+			return SUCCESS;
+		}
+	}
+    /*-----------------------------------------------------------------------------------------------------------------------------------------------------*/
+	char read_msg[BUFFER_SIZE];
+	char write_msg[BUFFER_SIZE];
+	int fd[2];
+	if (pipe(fd) == -1) {
+		fprintf(stderr,"Pipe failed");
+		return 1;
+	}
+	prepare_command(command);
+	fflush(stdout);
+	struct sigaction ignore = { .sa_handler = SIG_IGN }, old_int;
+	sigaction(SIGINT, &ignore, &old_int);     // Ctrl+C stops the command, not the shell
+    /*----------------------------------------------------------------------------------------------------------------------------------------------------*/
+	pid_t pid=fork();
+	if (pid==0) // child
+	{
+		command_child = true;
+		sigaction(SIGINT, &old_int, NULL);
+		signal(SIGPIPE, SIG_DFL);       // Commands die on a closed pipe, whatever the shell does
+		/// This shows how to do exec with environ (but is not available on MacOs)
+		// extern char** environ; // environment variables
+		// execvpe(command->name, command->args, environ); // exec+args+path+environ
+
+		/// This shows how to do exec with auto-path resolve
+		// add a NULL argument to the end of args, and the name to the beginning
+		// as required by exec
+
+		// increase args size by 2
+		command->args=(char **)realloc(
+				command->args, sizeof(char *)*(command->arg_count+=2));
+
+		// shift everything forward by 1
+		for (int i=command->arg_count-2;i>0;--i)
+			command->args[i]=command->args[i-1];
+
+			// set args[0] as a copy of name
+			command->args[0]=strdup(command->name);
+			// set args[arg_count-1] (last) to NULL
+			command->args[command->arg_count-1]=NULL;
+
+			//execvp(command->name, command->args); // exec+args+path
+
+			// Result cache: "cache COMMAND ARGS" caches any command, kdiff and highlight are cached implicitly
+			if(strcmp(command->name,"cache")==0){
+				if(command->args[1] == NULL){
+					printf("Missing command\n");
+					exit(1);
+				}
+				free(command->args[0]);
+				for (int i=0;i<command->arg_count-1;++i)  // Drop "cache" and run the rest as the command
+					command->args[i]=command->args[i+1];
+				command->arg_count--;
+				command->name=command->args[0];
+				cache_run(command->args);
+			} else if(strcmp(command->name,"kdiff")==0
+					|| (strcmp(command->name,"highlight")==0 && !highlight_follows(command->args))){
+				cache_run(command->args);
+			}
+
+			/*---------------------------------------------------------------------------------------------------------------------------------------------*/		
+			// Part 2
+			if(strcmp(command->name,"shortdir")==0){	  
+				if(command->args[1] == NULL){
+					printf("Missing parameters\n");
+					exit(1);
+				} 	    		    
+				char *comm = command->args[1];
+				char *filePath = SHORTDIR_FILE;
+				char *tempfilePath = SHORTDIR_TEMP_FILE;
+
+				if( strcmp(comm,"set") == 0){   // shortdir set - command
+					if(command->args[2] == NULL){
+						printf("Please enter an alias name\n");
+						exit(1);
+					}
+					char *name = command->args[2];
+					char cwd[1024];     // Location information
+					getcwd(cwd, sizeof(cwd));
+					remove_entry(filePath, tempfilePath, name, ':');    // If a given name is already an existing association, drop it
+					FILE *fptr;
+					fptr = fopen(filePath,"a");
+					fprintf(fptr,"%s:%s\n",name,cwd);  // Write to file
+					printf("%s is set as an alias for %s\n", name, cwd);   // Print to console
+					fclose(fptr);
+
+				} else if(strcmp(comm,"del")==0){
+					if(command->args[2] == NULL){
+						printf("Please enter an alias name\n");
+						exit(1);
+					}
+					remove_entry(filePath, tempfilePath, command->args[2], ':');
+				} else if(strcmp(comm,"clear")==0){     
+					FILE *fptr;
+					fptr = fopen(filePath,"w");     // Opening a file in writing mode removes all entries in the file,
+					fclose(fptr);                   // which is enough for our purpose
+
+				} else if(strcmp(comm,"list")==0){
+					fwrite(alias_table.data, 1, alias_table.len, stdout);       // Prints all the lines
+
+				} else if(strcmp(comm,"jump")==0){    
+					if(command->args[2] == NULL){
+						printf("Please enter an alias name\n");
+						exit(1);
+					}
+					char *name = command->args[2];
+					char *path = shortdir_target(name);    // Exact alias, or the best fuzzy match
+					if(path == NULL){
+						printf("No alias or visited directory matches %s\n", name);
+						exit(1);
+					}
+
+                    //chdir(path);       // Does not change directory. So we switched to the pipes
+
+					close(fd[READ_END]);		
+					write(fd[WRITE_END], path, strlen(path)+1);     // Send the path information to the parent through a pipe
+					close(fd[WRITE_END]);
+	
+				} else {
+					printf("Invalid argument\n");
+					exit(1);
+				}
+
+			}
+			// Part 3
+			else if(strcmp(command->name,"highlight")==0){		
+				int first = 1;
+				bool follow = false;
+				bool regex = false;
+				while(command->args[first] != NULL && (strcmp(command->args[first], "-f") == 0 || strcmp(command->args[first], "-e") == 0)){
+					if(strcmp(command->args[first], "-f") == 0)     // highlight -f word color file
+						follow = true;
+					else                                            // highlight -e regex color file
+						regex = true;
+					first++;
+				}
+				if(command->args[first] == NULL || command->args[first+1] == NULL || command->args[first+2] == NULL) { // Missing parameters
+					printf("Missing parameters\n");
+					exit(1);
+				}
+				char *word = command->args[first];
+				char *file = command->args[first+2];
+				char *color = command->args[first+1];
+				if(strcmp(color, "r") != 0 && strcmp(color, "g") != 0 && strcmp(color, "b") != 0){ // Invalid color
+					printf("Invalid color\n");
+					exit(1);
+				}
+
+				struct regex *rx = NULL;
+				if(regex){
+					const char *error;
+					rx = regex_compile(word, &error);
+					if(rx == NULL){
+						printf("Invalid regular expression: %s\n", error);
+						exit(1);
+					}
+				}
+
+				if(follow){     // Keep watching the file for appended lines
+					highlight_follow(file, word, color, rx);
+					exit(1);
+				}
+				struct line_reader reader;
+				if(line_reader_open(&reader, file) == -1){     // Open the file in read only mode
+					printf("-%s: %s: %s: %s\n", sysname, command->name, file, strerror(errno));
+					exit(1);
+				}
+				const char *line;
+				size_t len;
+				while( (line = line_reader_next(&reader, &len)) != NULL ){  
+					highlight_line(line, len, word, color, rx);
+				}
+				line_reader_close(&reader);
+				if(rx)
+					regex_free(rx);
+				if(reader.in.error){
+					printf("-%s: %s: %s: %s\n", sysname, command->name, file, strerror(reader.in.error));
+					exit(1);
+				}
+
+			}
+			// Part 4
+			else if(strcmp(command->name,"goodMorning")==0){
+				if(command->args[2] == NULL|| command->args[1] == NULL) { // Missing parameters
+					printf("Missing parameters\n");
+					exit(1);
 				}
 				char alarmfilePath[1024];     // Location information
 				getcwd(alarmfilePath, sizeof(alarmfilePath)); 
@@ -595,60 +3383,66 @@ int process_command(struct command_t *command)
 				fprintf(falarm, "%s %s * * * XDG_RUNTIME_DIR=/run/user/$(id -u) /usr/bin/rhythmbox-client --play %s\n", minute, hour, musicFile);
 				fclose(falarm); 
 				execlp("crontab","crontab", alarmfilePath, NULL);
+				printf("-%s: crontab: %s\n", sysname, strerror(errno));
+				exit(1);
 			}
 
 			//Part 5
 			else if(strcmp(command->name, "kdiff") == 0){
 				char *flag = command->args[1];
-				char file1[100];
-				char file2[100];
+				char *file1;
+				char *file2;
 
 				if(flag == NULL) {
 					printf("Please enter at least 2 file names\n");
+					exit(1);
 				} else if(command->args[2] == NULL){
 					printf("Please enter a valid number of arguments\n");
+					exit(1);
 				} else {
 					if(command->args[3] == NULL){   
-						strcpy(file1, command->args[1]);
-						strcpy(file2, command->args[2]);
-						strcpy(flag, "-a");
+						file1 = command->args[1];
+						file2 = command->args[2];
+						flag = "-a";
 					} else {
-						strcpy(file1,command->args[2]);
-						strcpy(file2,command->args[3]);
+						file1 = command->args[2];
+						file2 = command->args[3];
 					}   
 
 					if( strcmp(flag, "-a") ==0) {   // Compare line by line
-						FILE *fPtr1;
-						FILE *fPtr2;
-						fPtr1 = fopen(file1,"r");
-						fPtr2 = fopen(file2,"r");
-						char lines1[1000][1000];    // 2D array to hold the lines of file 1
-						char lines2[1000][1000];    // 2D array to hold the lines of file 2
-						int number = 0;
-						int totalMistakes = 0;
-
-						char buffer1[99999];
-						while( fgets(buffer1, 99999, fPtr1) != NULL ){  // Populate array 1
-							strcpy(lines1[number],buffer1);
-							number++;                  
+						struct line_reader r1, r2;
+						if(line_reader_open(&r1, file1) == -1){
+							printf("-%s: kdiff: %s: %s\n", sysname, file1, strerror(errno));
+							exit(1);
 						}
-						fclose(fPtr1);
-
-						number = 0;
-						char buffer2[99999];
-						while( fgets(buffer2, 99999, fPtr2) != NULL ){  // Populate array 2
-							strcpy(lines2[number],buffer2);
-							number++;                  
+						if(line_reader_open(&r2, file2) == -1){
+							printf("-%s: kdiff: %s: %s\n", sysname, file2, strerror(errno));
+							exit(1);
 						}
-						fclose(fPtr2);
-
-						for(int i =0; i<number; i++){   // Compare 2 array, line by line
-							if(strcmp( lines1[i], lines2[i]) != 0){
+						int number = 0;
+						int totalMistakes = 0;
+						const char *line1, *line2;
+						size_t len1, len2;
+						while(1){   // Compare the 2 files, line by line
+							line1 = line_reader_next(&r1, &len1);
+							line2 = line_reader_next(&r2, &len2);
+							if(line1 == NULL && line2 == NULL)
+								break;
+							number++;
+							if(line1 == NULL){ line1 = ""; len1 = 0; }    // One file ended, compare with an empty line
+							if(line2 == NULL){ line2 = ""; len2 = 0; }
+							if(len1 != len2 || memcmp(line1, line2, len1) != 0){
 								totalMistakes++;
-								printf("%s:Line %d: %s", file1, i+1, lines1[i]);
-								printf("%s:Line %d: %s", file2, i+1, lines2[i]);
+								printf("%s:Line %d: %.*s%s", file1, number, (int)len1, line1, len1 && line1[len1-1] == '\n' ? "" : "\n");
+								printf("%s:Line %d: %.*s%s", file2, number, (int)len2, line2, len2 && line2[len2-1] == '\n' ? "" : "\n");
 							}
 						}
+						line_reader_close(&r1);
+						line_reader_close(&r2);
+						if(r1.in.error || r2.in.error){
+							printf("-%s: kdiff: %s: %s\n", sysname, r1.in.error ? file1 : file2, strerror(r1.in.error ? r1.in.error : r2.in.error));
+							exit(1);
+						}
 
 						if(totalMistakes == 0){
 							printf("%s","The two files are identical\n");
@@ -657,30 +3451,52 @@ int process_command(struct command_t *command)
 						}
 
 					} else if( strcmp(flag, "-b") ==0) {    // Compare byte by byte
-						FILE *fPtr1;
-						FILE *fPtr2;
-						fPtr1 = fopen(file1,"rb");  // Open in rad byte mode
-						fPtr2 = fopen(file2,"rb");
-
-						unsigned long pos;
-						int c1, c2;
-						int totalMistakes= 0;
-						for (pos = 0;; pos++) {     // Read a byte from both files and compare
-							c1 = getc(fPtr1);
-							c2 = getc(fPtr2);
-							if (c1 != c2){
-								totalMistakes += 1;
+						struct input in1, in2;
+						if(input_open(&in1, file1) == -1){     // Decompressed if needed
+							printf("-%s: kdiff: %s: %s\n", sysname, file1, strerror(errno));
+							exit(1);
+						}
+						if(input_open(&in2, file2) == -1){
+							printf("-%s: kdiff: %s: %s\n", sysname, file2, strerror(errno));
+							exit(1);
+						}
+						unsigned char *buf1 = malloc(INPUT_CHUNK);
+						unsigned char *buf2 = malloc(INPUT_CHUNK);
+						unsigned long pos = 0;
+						unsigned long totalMistakes = 0;
+						while(1){   // Read a block from both files and compare byte by byte
+							size_t n1 = input_read_full(&in1, buf1, INPUT_CHUNK);
+							size_t n2 = input_read_full(&in2, buf2, INPUT_CHUNK);
+							size_t common = n1 < n2 ? n1 : n2;
+							for(size_t i = 0; i < common; i++){
+								if(buf1[i] != buf2[i]){
+									totalMistakes += 1;
+								}
 							}
-							if (c1 == EOF || c1 == EOF)
+							totalMistakes += (n1 > n2 ? n1 - n2 : n2 - n1);     // Bytes past the end of the shorter file
+							pos += n1 > n2 ? n1 : n2;
+							if(n1 == 0 && n2 == 0)
 								break;
 						}
+						free(buf1);
+						free(buf2);
+						input_close(&in1);
+						input_close(&in2);
+						if(in1.error || in2.error){
+							printf("-%s: kdiff: %s: %s\n", sysname, in1.error ? file1 : file2, strerror(in1.error ? in1.error : in2.error));
+							exit(1);
+						}
 						if (totalMistakes == 0) {
 							printf("The two files are identical and have %lu bytes\n", pos);
 						} else{
-							printf("The two files are different in %d bytes\n", totalMistakes);
+							printf("The two files are different in %lu bytes\n", totalMistakes);
 						} 
+					} else if( strcmp(flag, "-d") ==0) {    // Delta of shifted regions
+						if(kdiff_delta(file1, file2) == -1)
+							exit(1);
 					} else{
-						printf("Given mode argument is invalid. Please use -a or -b.\n");
+						printf("Given mode argument is invalid. Please use -a, -b or -d.\n");
+						exit(1);
 					}
 				}
 
@@ -692,108 +3508,62 @@ int process_command(struct command_t *command)
 				char *mode = command->args[1];
 				char *class_name = command->args[2];
 
-				char *fileName = "zoom_classes.txt";
-				char *tempfileName = "tempzoom_classes.txt";
+				char *fileName = ZOOM_FILE;
+				char *tempfileName = ZOOM_TEMP_FILE;
 
-				FILE *fptr;
-				fptr = fopen(fileName,"a+");    // Need both append and reading modes
+				if(mode == NULL || (strcmp(mode, "-l") != 0 && strcmp(mode, "-c") != 0 && class_name == NULL)){
+					printf("Missing parameters\n");
+					exit(1);
+				}
 
 				if( strcmp(mode, "-s") ==0) {   //save a class
 					char *link = command->args[3];
 					char *password = command->args[4];	
-					char *saved_class[99999];
-					strcpy(saved_class,class_name);
-					strcat(saved_class," ");
-					strcat(saved_class,link);
-					strcat(saved_class," ");
-					strcat(saved_class,password); 
-
-					char buffer[99999];
-					char *last_token;
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						last_token = strtok( buffer, " " );
-						if(strcmp(last_token, class_name)==0){    // If a given name is already an existing association
-							fclose(fptr);   // To do not mess up with open files, close it and reopen it
-							fptr = fopen(fileName,"a+");
-							FILE *ftemp;    // Temporary file to hold the original file with deleted line
-							ftemp = fopen(tempfileName,"a");
-							char buffer2[99999];
-							char *last_token2;
-							while( fgets(buffer2, 99999, fptr) != NULL ){  
-								last_token2 = strtok( buffer2, " " );
-								if(strcmp(last_token2,class_name)!=0){    // Copy all the lines except the one with given name
-									char line[512];
-									strcpy(line, last_token2);
-									last_token2 = strtok( NULL, " " );
-									strcat(line, " ");
-									strcat(line, last_token2);
-									last_token2 = strtok( NULL, " " );
-									strcat(line, " ");
-									strcat(line, last_token2);
-									fprintf(ftemp,"%s",line);
-								}   
-							}
-							fclose(ftemp);  // Close both files
-							fclose(fptr);
-							rename(tempfileName,fileName);  // Change the name of temporary file to original file name
-							fptr = fopen(fileName,"a"); // Reopen the file
-						}                
+					if(link == NULL || password == NULL){
+						printf("Missing parameters\n");
+						exit(1);
 					}
-
-					fprintf(fptr,"%s\n",saved_class);
+					remove_entry(fileName, tempfileName, class_name, ' ');    // If a given name is already an existing association, drop it
+					FILE *fptr;
+					fptr = fopen(fileName,"a");
+					fprintf(fptr,"%s %s %s\n",class_name,link,password);
 					fclose(fptr);
 
 				} else if( strcmp(mode, "-o") ==0) {
-					char buffer[99999]; 
-					char *last_token;
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						last_token = strtok( buffer, " " );
-
-						if(strcmp(last_token,class_name)==0){    
-							char *link =  strtok( NULL, " " );    
-							char *password  = strtok( NULL, " " );
-							printf("Password for the class is: %s\n",password);       // To ease of use, print the password to the console      
-							char *xdg[99999];
-							strcat(xdg,"xdg-open ");
-							strcat(xdg,link);
-							system(xdg);        // Use system() call to open the link in the browser
-							fclose(fptr);
-						}   
-					} 
+					struct line_reader reader;
+					const char *line;
+					size_t len;
+					if(zoom_table.data != NULL){
+						line_reader_memory(&reader, zoom_table.data, zoom_table.len);
+						while( (line = line_reader_next(&reader, &len)) != NULL ){  
+							if(entry_matches(line, len, class_name, ' ')){    
+								char *entry = strndup(line, len);
+								strtok( entry, " " );
+								char *link =  strtok( NULL, " \n" );    
+								char *password  = strtok( NULL, " \n" );
+								if(link == NULL) link = "";
+								if(password == NULL) password = "";
+								printf("Password for the class is: %s\n",password);       // To ease of use, print the password to the console      
+								char *xdg = malloc(strlen(link) + sizeof("xdg-open "));
+								strcpy(xdg,"xdg-open ");
+								strcat(xdg,link);
+								system(xdg);        // Use system() call to open the link in the browser
+								free(xdg);
+								free(entry);
+								break;
+							}   
+						} 
+						line_reader_close(&reader);
+					}
 
 				} else if( strcmp(mode, "-d") == 0) { 
-					FILE *ftemp;
-					ftemp = fopen(tempfileName,"a");
-
-					char buffer[99999];
-					char *last_token;
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						last_token = strtok( buffer, " " );
-						if(strcmp(last_token,class_name)!=0){     // Copy all the lines except the one with given name
-							char line[512];
-							strcpy(line, last_token);
-							last_token = strtok( NULL, " " );
-							strcat(line," ");
-							strcat(line, last_token);
-							last_token = strtok( NULL, " " );
-							strcat(line," ");
-							strcat(line, last_token);
-							fprintf(ftemp,"%s",line);
-						}   
-					}
-					fclose(ftemp);
-					fclose(fptr);
-					rename(tempfileName,fileName);   // Rename the temp file as the original one
+					remove_entry(fileName, tempfileName, class_name, ' ');   // Rename the temp file as the original one
 
 				} else if( strcmp(mode, "-l") == 0){
-					char buffer[99999];
-					while( fgets(buffer, 99999, fptr) != NULL ){  
-						printf("%s", buffer);               // Prints all the lines                      
-					}
-					fclose(fptr);
+					fwrite(zoom_table.data, 1, zoom_table.len, stdout);      // Prints all the lines                      
 
 				} else if( strcmp(mode, "-c") == 0){
-					fclose(fptr);
+					FILE *fptr;
 					fptr = fopen(fileName,"w");     // Opening a file in writing mode removes all entries in the file,
 					fclose(fptr); 
 				}
@@ -802,33 +3572,14 @@ int process_command(struct command_t *command)
 			}
 			// Part 1
 			else {
-				char *path = strdup(getenv("PATH"));
-				if (NULL == path) return NULL;
-				char *tok = strtok(path, WHICH_DELIMITER);  // Tokenize environment paths with ":"
-				char location[1024];
-
-				while (tok) {
-					// path
-					int len = strlen(tok) + 2 + strlen(command->name);
-					char *file = malloc(len);
-					if (!file) {    // If there is not enough memory to open the corresponding file, free the 
-						free(path); // path variable and return.
-						return NULL;
-					}
-
-					sprintf(file, "%s/%s", tok, command->name);     // Desired format for wanted command
-
-					if (0 == access(file, X_OK)) {  // If file is openable, in the current location
-						free(path);
-						strcpy(location,file);  // Copy the location information and pass it to execv in below
-					}
-
-					// next token
-					tok = strtok(NULL, WHICH_DELIMITER);
-					free(file);
+				const char *location = resolve_command(command->name);    // Look the command up in the (inherited) PATH cache
+				if (location == NULL) {
+					printf("-%s: %s: command not found\n", sysname, command->name);
+					exit(127);
 				}
-
 				execv(location, command->args);
+				printf("-%s: %s: %s\n", sysname, command->name, strerror(errno));
+				exit(126);
 			}	
 			/*---------------------------------------------------------------------------------------------------------------------------------------------*/
 			exit(0);
@@ -836,15 +3587,16 @@ int process_command(struct command_t *command)
 	}
 	else
 	{
-		wait(0);
+		int status;
+		waitpid(pid, &status, 0);
+		last_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
 		close(fd[WRITE_END]);
-		read(fd[READ_END], read_msg, BUFFER_SIZE);  // Get output path from the pipe, which comes from the jump call of shortdir command
-		chdir(read_msg);        // Change directory to the path, derived from the pipe
+		if (read(fd[READ_END], read_msg, BUFFER_SIZE) > 0  // Get output path from the pipe, which comes from the jump call of shortdir command
+				&& chdir(read_msg) == 0)        // Change directory to the path, derived from the pipe
+			visits_add_cwd();
 		close(fd[READ_END]);
 
-		if (!command->background){
-			wait(0); // wait for child process to finish
-		}
+		sigaction(SIGINT, &old_int, NULL);
 		return SUCCESS;
 	}
 